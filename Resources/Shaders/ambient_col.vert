@@ -5,12 +5,27 @@ layout  (location = 0) in vec3 position;
 //layout (location = 2) in vec2 texCoord;
 //layout (location = 3) in vec4 colors;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 proj;
+// Blocs std140 (cf. SFrameUniforms et SObjectUniforms dans RenderQueue.h), identiques dans tous les shaders.
+// Les vec3 y occupent 16 octets.
+layout (std140) uniform FrameUniforms	// Lie une fois par frame.
+{
+	mat4 view;
+	mat4 proj;
+	vec3 cameraPosition;
+	vec3 lightPosition;
+	vec3 lightColor;
+};
+layout (std140) uniform ObjectUniforms	// Une tranche du ring buffer par draw.
+{
+	mat4 model;				// Non utilisee par les *_inst (matrice par instance).
+	mat3 normalMatrix;		// Couteux, calcule 1 fois a l'exterieur du shader via glm.
+	mat4 material;			// les 3 couleurs et parametres sont "compactes" dans une matrice 4x4
+	vec3 positionScale;		// Decodage des positions quantifiees (cf. CMesh), 1 et 0 pour des positions en float.
+	vec3 positionOffset;
+};
 
 void main()
 {
-	gl_Position = proj * view * model * vec4(position, 1.0);
+	gl_Position = proj * view * model * vec4(positionOffset + positionScale * position, 1.0);
 }
 
@@ -9,15 +9,29 @@ out vec2 TexCoord;
 out vec3 fragPos;		// Position du fragment.
 out vec3 normalSurf;	// Normal à la surface.
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 proj;
-uniform mat3 normalMatrix;  // Couteux, calculé 1 fois à l’extérieur du shader via glm.
+// Blocs std140 (cf. SFrameUniforms et SObjectUniforms dans RenderQueue.h), identiques dans tous les shaders.
+// Les vec3 y occupent 16 octets.
+layout (std140) uniform FrameUniforms	// Lie une fois par frame.
+{
+	mat4 view;
+	mat4 proj;
+	vec3 cameraPosition;
+	vec3 lightPosition;
+	vec3 lightColor;
+};
+layout (std140) uniform ObjectUniforms	// Une tranche du ring buffer par draw.
+{
+	mat4 model;				// Non utilisee par les *_inst (matrice par instance).
+	mat3 normalMatrix;		// Couteux, calcule 1 fois a l'exterieur du shader via glm.
+	mat4 material;			// les 3 couleurs et parametres sont "compactes" dans une matrice 4x4
+	vec3 positionScale;		// Decodage des positions quantifiees (cf. CMesh), 1 et 0 pour des positions en float.
+	vec3 positionOffset;
+};
 
 void main()
 {
 	TexCoord = vec2(texCoord.x, texCoord.y);
-	vec4 fragWorldSpace = model * vec4(position, 1.0);
+	vec4 fragWorldSpace = model * vec4(positionOffset + positionScale * position, 1.0);
 	fragPos     = vec3(fragWorldSpace);		// Vertex dans l’espace world.
 	normalSurf  = normalMatrix * normals;	// Normal dans l’espace world.
 	gl_Position = proj * view * fragWorldSpace;
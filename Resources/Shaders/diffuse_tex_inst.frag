@@ -0,0 +1,35 @@
+#version 330 core
+
+in vec2 TexCoord;	// Issu du vertex shader, et interpolé entre les 3 sommets.
+in vec3 fragPos;	// Idem.
+in vec3 normalSurf;	// Idem.
+in vec4 fragColor;	// Couleur de l'instance.
+
+uniform sampler2D texture_diffuse;
+// Blocs std140 (cf. SFrameUniforms et SObjectUniforms dans RenderQueue.h), identiques dans tous les shaders.
+// Les vec3 y occupent 16 octets.
+layout (std140) uniform FrameUniforms	// Lie une fois par frame.
+{
+	mat4 view;
+	mat4 proj;
+	vec3 cameraPosition;
+	vec3 lightPosition;
+	vec3 lightColor;
+};
+layout (std140) uniform ObjectUniforms	// Une tranche du ring buffer par draw.
+{
+	mat4 model;				// Non utilisee par les *_inst (matrice par instance).
+	mat3 normalMatrix;		// Couteux, calcule 1 fois a l'exterieur du shader via glm.
+	mat4 material;			// les 3 couleurs et parametres sont "compactes" dans une matrice 4x4
+	vec3 positionScale;		// Decodage des positions quantifiees (cf. CMesh), 1 et 0 pour des positions en float.
+	vec3 positionOffset;
+};
+
+void main()
+{
+	vec3 N = normalize(normalSurf);
+	vec3 L = normalize(lightPosition - fragPos);
+	float diffuse = max(0,dot(N,L));
+	
+	gl_FragColor = texture(texture_diffuse, TexCoord)*vec4(diffuse * lightColor,1)*fragColor;
+}
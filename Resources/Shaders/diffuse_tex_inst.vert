@@ -0,0 +1,42 @@
+#version 330 core
+
+layout  (location = 0) in vec3 position;
+layout  (location = 1) in vec3 normals;
+layout  (location = 2) in vec2 texCoord;
+layout  (location = 4) in mat4 instanceModel;	// Attributs d'instance (locations 4 a 7, glVertexAttribDivisor = 1).
+layout  (location = 8) in vec4 instanceColor;	// Idem.
+
+out vec2 TexCoord;
+out vec3 fragPos;		// Position du fragment.
+out vec3 normalSurf;	// Normal à la surface.
+out vec4 fragColor;		// Couleur de l'instance.
+
+// Blocs std140 (cf. SFrameUniforms et SObjectUniforms dans RenderQueue.h), identiques dans tous les shaders.
+// Les vec3 y occupent 16 octets.
+layout (std140) uniform FrameUniforms	// Lie une fois par frame.
+{
+	mat4 view;
+	mat4 proj;
+	vec3 cameraPosition;
+	vec3 lightPosition;
+	vec3 lightColor;
+};
+layout (std140) uniform ObjectUniforms	// Une tranche du ring buffer par draw.
+{
+	mat4 model;				// Non utilisee par les *_inst (matrice par instance).
+	mat3 normalMatrix;		// Couteux, calcule 1 fois a l'exterieur du shader via glm.
+	mat4 material;			// les 3 couleurs et parametres sont "compactes" dans une matrice 4x4
+	vec3 positionScale;		// Decodage des positions quantifiees (cf. CMesh), 1 et 0 pour des positions en float.
+	vec3 positionOffset;
+};
+
+void main()
+{
+	TexCoord = vec2(texCoord.x, texCoord.y);
+	vec4 fragWorldSpace = instanceModel * vec4(positionOffset + positionScale * position, 1.0);
+	fragPos     = vec3(fragWorldSpace);		// Vertex dans l’espace world.
+	// Rotation * echelle uniforme : mat3(model) suffit, la normale est renormalisee dans le fragment shader.
+	normalSurf  = mat3(instanceModel) * normals;
+	fragColor   = instanceColor;
+	gl_Position = proj * view * fragWorldSpace;
+}
@@ -3,10 +3,24 @@
 in vec3 fragPos;	// Issu du vertex shader, et interpolé entre les 3 sommets.
 in vec3 normalSurf;	// Idem.
 
-uniform mat4  material;		// les 3 couleurs et paramètres sont "compactés" dans une matrice 4x4
-uniform vec3  lightColor;
-uniform vec3  lightPosition;
-uniform vec3  cameraPosition;
+// Blocs std140 (cf. SFrameUniforms et SObjectUniforms dans RenderQueue.h), identiques dans tous les shaders.
+// Les vec3 y occupent 16 octets.
+layout (std140) uniform FrameUniforms	// Lie une fois par frame.
+{
+	mat4 view;
+	mat4 proj;
+	vec3 cameraPosition;
+	vec3 lightPosition;
+	vec3 lightColor;
+};
+layout (std140) uniform ObjectUniforms	// Une tranche du ring buffer par draw.
+{
+	mat4 model;				// Non utilisee par les *_inst (matrice par instance).
+	mat3 normalMatrix;		// Couteux, calcule 1 fois a l'exterieur du shader via glm.
+	mat4 material;			// les 3 couleurs et parametres sont "compactes" dans une matrice 4x4
+	vec3 positionScale;		// Decodage des positions quantifiees (cf. CMesh), 1 et 0 pour des positions en float.
+	vec3 positionOffset;
+};
 
 
 //float getExponentialFogFactor(float c)
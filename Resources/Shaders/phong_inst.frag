@@ -0,0 +1,43 @@
+#version 330 core
+
+in vec3 fragPos;	// Issu du vertex shader, et interpolé entre les 3 sommets.
+in vec3 normalSurf;	// Idem.
+in vec4 fragColor;	// Couleur de l'instance.
+
+// Blocs std140 (cf. SFrameUniforms et SObjectUniforms dans RenderQueue.h), identiques dans tous les shaders.
+// Les vec3 y occupent 16 octets.
+layout (std140) uniform FrameUniforms	// Lie une fois par frame.
+{
+	mat4 view;
+	mat4 proj;
+	vec3 cameraPosition;
+	vec3 lightPosition;
+	vec3 lightColor;
+};
+layout (std140) uniform ObjectUniforms	// Une tranche du ring buffer par draw.
+{
+	mat4 model;				// Non utilisee par les *_inst (matrice par instance).
+	mat3 normalMatrix;		// Couteux, calcule 1 fois a l'exterieur du shader via glm.
+	mat4 material;			// les 3 couleurs et parametres sont "compactes" dans une matrice 4x4
+	vec3 positionScale;		// Decodage des positions quantifiees (cf. CMesh), 1 et 0 pour des positions en float.
+	vec3 positionOffset;
+};
+
+void main()
+{
+	// Extraction des couleurs et paramètres
+	vec3 ambientColor  = vec3(material[0][0],material[0][1],material[0][2]);
+	vec3 diffuseColor  = vec3(material[0][1],material[1][1],material[1][2]);
+	vec3 specularColor = vec3(material[0][2],material[2][1],material[2][2]);
+	float shininess    = material[3][0];
+	
+	vec3 N = normalize(normalSurf);
+	vec3 L = normalize(lightPosition - fragPos);
+	vec3 R = reflect(-L,N);
+	vec3 V = normalize(cameraPosition - fragPos);
+	float diffuse   = max(0,dot(N,L));
+	float specular  = pow(max(dot(V,R), 0.0), shininess);
+	
+	vec3 color = lightColor * (ambientColor + diffuse*diffuseColor + specular*specularColor);
+	gl_FragColor = vec4(color,1) * fragColor;
+}
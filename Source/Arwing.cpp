@@ -30,10 +30,10 @@ CArwing::CArwing(CWorld* const World, CModel* const Model) : CParent(World, EEnt
 		else assert(-maxAngularVelocity <= angularVelocity && angularVelocity <= -minAngularVelocity);
 	}
 
-	// Initial transform. Scaling is performed last only when drawing the model (cf. CEntity::Draw).
-	ModelMatrix = glm::mat4(1.f);
-	ModelMatrix = glm::rotate(ModelMatrix, glm::radians(90.f), glm::vec3(1.f, 0.f, 0.f));
-	ModelMatrix = glm::rotate(ModelMatrix, glm::radians(180.f), glm::vec3(0.f, 0.f, 1.f));
+	// Initial transform. Scaling is performed last only when drawing the model (cf. CEntity::Submit).
+	Transform = STransform();
+	Transform.Rotate(glm::radians(90.f), glm::vec3(1.f, 0.f, 0.f));
+	Transform.Rotate(glm::radians(180.f), glm::vec3(0.f, 0.f, 1.f));
 	Size = 7.f; // Biggest extent: 7m (probably from front to back).
 }
 
@@ -42,12 +42,12 @@ void CArwing::InitializeRigidBody(rp3d::PhysicsCommon& PhysicsCommon, rp3d::Phys
 	using namespace rp3d;
 	if (!Model) { RigidBody = nullptr; return; }
 
-	Transform transform; transform.setFromOpenGL(reinterpret_cast<decimal*>(&ModelMatrix));
-	RigidBody = PhysicsWorld->createRigidBody(transform);
+	RigidBody = PhysicsWorld->createRigidBody(Transform.ToPhysics());
 
 	Vector3 const boxHalfExtents = 0.5f * NormalizingScalingFactor * Size * Model->GetAABB().GetLength();
 	BoxShape* box = PhysicsCommon.createBoxShape(boxHalfExtents);
 	RigidBody->addCollider(box, rp3d::Transform::identity());
+	ApplyCollisionLayer();
 
 	RigidBody->setType(BodyType::KINEMATIC);
 	// RigidBody->setMass(Mass);
@@ -69,9 +69,9 @@ void CArwing::Update(float const Dt)
 	
 	// ANGULAR MOTION.
 	// Rotating (pitch, then roll, then yaw).
-	ModelMatrix = glm::rotate(ModelMatrix, glm::radians(AngularVelocities[int(EDirection::Right)] * Dt), GetLocalRightAxis());
-	ModelMatrix = glm::rotate(ModelMatrix, glm::radians(AngularVelocities[int(EDirection::Forward)] * Dt), localForwardAxis);
-	ModelMatrix = glm::rotate(ModelMatrix, glm::radians(AngularVelocities[int(EDirection::Up)] * Dt), GetLocalUpAxis());
+	Transform.Rotate(glm::radians(AngularVelocities[int(EDirection::Right)] * Dt), GetLocalRightAxis());
+	Transform.Rotate(glm::radians(AngularVelocities[int(EDirection::Forward)] * Dt), localForwardAxis);
+	Transform.Rotate(glm::radians(AngularVelocities[int(EDirection::Up)] * Dt), GetLocalUpAxis());
 
 	for (int iAxis = 0; iAxis < Dim; iAxis++)
 	{
@@ -87,8 +87,7 @@ void CArwing::Update(float const Dt)
 
 	// LINEAR MOTION.
 	// Translating.
-	ResetScale();
-	ModelMatrix = glm::translate(ModelMatrix, LinearVelocity * Dt * localForwardAxis);
+	Transform.Translate(LinearVelocity * Dt * localForwardAxis);
 
 	// Decaying linear velocity.
 	LinearVelocity -= LinearDamping * Dt;
@@ -97,10 +96,9 @@ void CArwing::Update(float const Dt)
 	LinearVelocity = std::clamp(LinearVelocity, MinLinearVelocity, MaxLinearVelocity);
 
 	// Passing the new transform to the kinematic rigid body.
-	using namespace rp3d;
 	if (!RigidBody) return;
-	Transform transform; transform.setFromOpenGL(reinterpret_cast<decimal*>(&ModelMatrix));
-	RigidBody->setTransform(transform);
+	rp3d::RigidBody* const body = RigidBody;
+	World->ExecuteOnPhysics([body, transform = Transform.ToPhysics()]() { body->setTransform(transform); });
 }
 
 void CArwing::Accelerate(float const Dt)
@@ -157,17 +155,17 @@ void CArwing::GoDown(float const Dt)
 
 glm::vec3 CArwing::GetForwardAxis() const
 {
-	return glm::normalize(glm::vec3(ModelMatrix[1]));
+	return Transform.GetAxis(1);
 }
 
 glm::vec3 CArwing::GetUpAxis() const
 {
-	return -glm::normalize(glm::vec3(ModelMatrix[2]));
+	return -Transform.GetAxis(2);
 }
 
 glm::vec3 CArwing::GetRightAxis() const
 {
-	return -glm::normalize(glm::vec3(ModelMatrix[0]));
+	return -Transform.GetAxis(0);
 }
 
 CCameraTarget CArwing::GetCameraTarget() const
@@ -0,0 +1,97 @@
+#include "AssetLoader.h"
+
+CAssetLoader::CAssetLoader(uint32_t NumberOfThreads)
+{
+	if (NumberOfThreads == 0) NumberOfThreads = std::clamp(std::thread::hardware_concurrency(), 2u, 3u) - 1;
+	for (uint32_t k = 0; k < NumberOfThreads; k++) Workers.emplace_back(&CAssetLoader::WorkerLoop, this);
+}
+
+CAssetLoader::~CAssetLoader()
+{
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		Quit = true;
+		Jobs.clear();
+	}
+	JobCondition.notify_all();
+	for (std::thread& worker : Workers) worker.join();
+}
+
+void CAssetLoader::Enqueue(FJob&& Job)
+{
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		Jobs.push_back(std::move(Job));
+	}
+	JobCondition.notify_one();
+}
+
+void CAssetLoader::EnqueueUpload(FJob&& Upload)
+{
+	std::lock_guard<std::mutex> lock(Mutex);
+	Uploads.push_back(std::move(Upload));
+}
+
+void CAssetLoader::NotifyProgress()
+{
+	// Locking so that a WaitUntil between its check and its wait does not miss the notification.
+	{ std::lock_guard<std::mutex> lock(Mutex); }
+	ProgressCondition.notify_all();
+}
+
+uint32_t CAssetLoader::ProcessUploads(double const BudgetMs)
+{
+	std::chrono::steady_clock::time_point const startTime = std::chrono::steady_clock::now();
+	uint32_t numberOfUploads = 0;
+	double elapsed = 0.;
+	do
+	{
+		FJob upload;
+		{
+			std::lock_guard<std::mutex> lock(Mutex);
+			if (Uploads.empty()) break;
+			upload = std::move(Uploads.front());
+			Uploads.pop_front();
+		}
+		upload();
+		numberOfUploads++;
+		elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+	}
+	while (elapsed < BudgetMs);
+	LastUploadsTime = elapsed;
+	return numberOfUploads;
+}
+
+void CAssetLoader::WaitUntil(std::function<bool()> const& Predicate)
+{
+	std::unique_lock<std::mutex> lock(Mutex);
+	ProgressCondition.wait(lock, Predicate);
+}
+
+bool CAssetLoader::IsIdle() const
+{
+	std::lock_guard<std::mutex> lock(Mutex);
+	return Jobs.empty() && RunningJobs == 0 && Uploads.empty();
+}
+
+void CAssetLoader::WorkerLoop()
+{
+	while (true)
+	{
+		FJob job;
+		{
+			std::unique_lock<std::mutex> lock(Mutex);
+			JobCondition.wait(lock, [this]() { return Quit || !Jobs.empty(); });
+			if (Quit) return;
+			job = std::move(Jobs.front());
+			Jobs.pop_front();
+			RunningJobs++;
+		}
+		job();
+		{
+			std::lock_guard<std::mutex> lock(Mutex);
+			RunningJobs--;
+		}
+		ProgressCondition.notify_all();
+	}
+}
\ No newline at end of file
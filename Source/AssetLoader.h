@@ -0,0 +1,51 @@
+#pragma once
+#include "Types.h"
+
+// Background asset streaming.
+// The CPU side of the loads (file reading, Assimp import, image decoding) runs on worker threads, in order of
+// submission. What has to be done on the GL thread is queued back as uploads, run by ProcessUploads within a
+// time budget per frame so that streaming never causes a long frame.
+class CAssetLoader
+{
+public:
+	using FJob = std::function<void()>;
+
+	// 0 = as many threads as needed to keep a core free for the GL thread, 2 at most.
+	explicit CAssetLoader(uint32_t NumberOfThreads = 0);
+	// Waits for the jobs already running, drops the other jobs and the uploads.
+	~CAssetLoader();
+
+	CAssetLoader(CAssetLoader const&) = delete;
+	CAssetLoader& operator=(CAssetLoader const&) = delete;
+
+	// Any thread.
+	void Enqueue(FJob&& Job);
+	void EnqueueUpload(FJob&& Upload);
+	// To be called by the jobs when something the main thread may wait for (cf. WaitUntil) is available.
+	void NotifyProgress();
+
+	// GL thread only. Runs the uploads in order until BudgetMs is spent (at least one if any is pending).
+	// Returns the number of uploads run.
+	uint32_t ProcessUploads(double const BudgetMs);
+	// Blocks until Predicate is true. It is checked each time a job calls NotifyProgress or ends.
+	void WaitUntil(std::function<bool()> const& Predicate);
+
+	// No job queued or running and no upload pending.
+	bool IsIdle() const;
+	double GetLastUploadsTime() const { return LastUploadsTime; } // In ms.
+
+private:
+	vector<std::thread> Workers;
+
+	mutable std::mutex Mutex;
+	std::condition_variable JobCondition;
+	std::condition_variable ProgressCondition;
+	std::deque<FJob> Jobs;
+	std::deque<FJob> Uploads;
+	uint32_t RunningJobs = 0;
+	bool Quit = false;
+
+	double LastUploadsTime = 0.;
+
+	void WorkerLoop();
+};
\ No newline at end of file
@@ -0,0 +1,163 @@
+#include "AsteroidPoolSoA.h"
+#include "Util.h"
+
+CAsteroidPoolSoA::CAsteroidPoolSoA(uint32_t const Capacity, CModel* const Model) : Capacity(Capacity), Model(Model)
+{
+	assert(Capacity > 0);
+	PositionsX.resize(Capacity, 0.f);
+	PositionsY.resize(Capacity, 0.f);
+	PositionsZ.resize(Capacity, 0.f);
+	Orientations.resize(Capacity, rp3d::Quaternion::identity());
+	Sizes.resize(Capacity, 1.f);
+	ActiveFlags.resize(Capacity, 0);
+	RigidBodies.resize(Capacity, nullptr);
+
+	if (Model && Model->IsLoaded()) NormalizingScalingFactor = 1.f / Model->GetAABB().GetMaxLength();
+}
+
+void CAsteroidPoolSoA::InitializeRigidBodies(CCollisionShapeCache& Shapes, rp3d::PhysicsWorld* const PhysicsWorld)
+{
+	this->Shapes = &Shapes;
+	using namespace rp3d;
+	CAsteroid::SParams const params;
+	CRandomizer r;
+
+	for (uint32_t index = 0; index < Capacity; index++)
+	{
+		// Same setup as CAsteroid::InitializeRigidBody.
+		Sizes[index] = r.GetRandomFloat(params.MinSize, params.MaxSize);
+		RigidBody* const rigidBody = PhysicsWorld->createRigidBody(Transform::identity());
+		Shapes.SetSphere(rigidBody, Sizes[index]);
+		// Same layer as CAsteroid (cf. CEntity::GetCollideWithMask).
+		rigidBody->getCollider(0)->setCollisionCategoryBits(CL_Asteroid);
+		rigidBody->getCollider(0)->setCollideWithMaskBits(CEntity::GetCollideWithMask(CL_Asteroid));
+		rigidBody->setLinearDamping(0.f);
+		rigidBody->setAngularDamping(0.f);
+		rigidBody->setMass(r.GetSameRandomFloat(params.MinMass, params.MaxMass));
+		rigidBody->setIsActive(false);
+		RigidBodies[index] = rigidBody;
+	}
+	NumberOfActive = 0;
+}
+
+void CAsteroidPoolSoA::DestroyRigidBodies(rp3d::PhysicsWorld* const PhysicsWorld)
+{
+	for (rp3d::RigidBody*& rigidBody : RigidBodies)
+	{
+		if (rigidBody) PhysicsWorld->destroyRigidBody(rigidBody);
+		rigidBody = nullptr;
+	}
+	NumberOfActive = 0;
+}
+
+bool CAsteroidPoolSoA::Spawn(CAsteroid::SParams const& Params)
+{
+	if (NumberOfActive == Capacity) return false;
+	uint32_t const index = NumberOfActive++;
+	rp3d::RigidBody* const rigidBody = RigidBodies[index];
+	assert(rigidBody);
+
+	// Same maths as CAsteroid::Randomize.
+	CRandomizer r;
+	glm::mat4 modelMatrix = glm::translate(glm::mat4(1.f), Params.PlayerPosition);
+
+	glm::vec3 randomDirection; r.GetRandomVector(randomDirection);
+	float const randomDistance = r.GetRandomFloat(Params.MinSpawnDistanceFromPlayer, Params.MaxSpawnDistanceFromPlayer);
+	modelMatrix = glm::translate(modelMatrix, randomDistance * randomDirection);
+
+	glm::vec3 randomRotationAxis; r.GetRandomVector(randomRotationAxis);
+	float const randomRotationAngle = glm::radians(r.GetRandomFloat(0.f, 360.f));
+	modelMatrix = glm::rotate(modelMatrix, randomRotationAngle, randomRotationAxis);
+
+	Sizes[index] = r.GetRandomFloat(Params.MinSize, Params.MaxSize);
+	float const mass = r.GetSameRandomFloat(Params.MinMass, Params.MaxMass);
+
+	rp3d::Vector3 linearVelocity; r.GetRandomVector(linearVelocity);
+	linearVelocity *= r.GetRandomFloat(Params.MinLinearVelocity, Params.MaxLinearVelocity);
+	rp3d::Vector3 angularVelocity; r.GetRandomVector(angularVelocity);
+	angularVelocity *= r.GetRandomFloat(Params.MinAngularVelocity, Params.MaxAngularVelocity);
+
+	rp3d::Transform transform; transform.setFromOpenGL(reinterpret_cast<rp3d::decimal*>(&modelMatrix));
+	rigidBody->setTransform(transform);
+	Shapes->SetSphere(rigidBody, Sizes[index]);
+	rigidBody->setLinearVelocity(linearVelocity);
+	rigidBody->setAngularVelocity(angularVelocity);
+	rigidBody->setMass(mass);
+	rigidBody->setIsActive(true);
+
+	PositionsX[index] = transform.getPosition().x;
+	PositionsY[index] = transform.getPosition().y;
+	PositionsZ[index] = transform.getPosition().z;
+	Orientations[index] = transform.getOrientation();
+	ActiveFlags[index] = 1;
+	return true;
+}
+
+void CAsteroidPoolSoA::UpdateAllActive(glm::vec3 const& ArwingPosition, float const InterpolationFactor)
+{
+	uint32_t const numberOfActive = NumberOfActive;
+	float const despawnDistance2 = DespawnDistance * DespawnDistance;
+	float const ax = ArwingPosition.x, ay = ArwingPosition.y, az = ArwingPosition.z;
+
+	// Despawn test: branchless loop over contiguous floats (vectorized by the compiler).
+	float const* const x = PositionsX.data();
+	float const* const y = PositionsY.data();
+	float const* const z = PositionsZ.data();
+	uint8_t* const active = ActiveFlags.data();
+	for (uint32_t index = 0; index < numberOfActive; index++)
+	{
+		float const dx = x[index] - ax, dy = y[index] - ay, dz = z[index] - az;
+		active[index] = uint8_t(dx * dx + dy * dy + dz * dz < despawnDistance2);
+	}
+
+	// Compaction: despawned asteroids are swapped with the last active one.
+	// Going backwards so that the swapped-in asteroid has already been tested.
+	for (uint32_t index = numberOfActive; index-- > 0;)
+	{
+		if (active[index]) continue;
+		RigidBodies[index]->setIsActive(false);
+		SwapSlots(index, --NumberOfActive);
+	}
+
+	// Interpolation from the rigid bodies themselves (the previous transform is the last interpolated one): unlike the
+	// entities (cf. CPhysicsThread), this pool is used with a world stepped on the same thread.
+	for (uint32_t index = 0; index < NumberOfActive; index++)
+	{
+		rp3d::Transform const& bodyTransform = RigidBodies[index]->getTransform();
+		rp3d::Vector3 const& bodyPosition = bodyTransform.getPosition();
+		float const w = 1.f - InterpolationFactor;
+		PositionsX[index] = w * bodyPosition.x + InterpolationFactor * PositionsX[index];
+		PositionsY[index] = w * bodyPosition.y + InterpolationFactor * PositionsY[index];
+		PositionsZ[index] = w * bodyPosition.z + InterpolationFactor * PositionsZ[index];
+		Orientations[index] = rp3d::Quaternion::slerp(bodyTransform.getOrientation(), Orientations[index], InterpolationFactor);
+	}
+}
+
+void CAsteroidPoolSoA::SubmitAllActive(CRenderQueue& Queue)
+{
+	if (!Model) return;
+
+	Instances.resize(NumberOfActive);
+	for (uint32_t index = 0; index < NumberOfActive; index++)
+	{
+		glm::mat4& modelMatrix = Instances[index].ModelMatrix;
+		rp3d::Transform const transform(rp3d::Vector3(PositionsX[index], PositionsY[index], PositionsZ[index]), Orientations[index]);
+		transform.getOpenGLMatrix(reinterpret_cast<rp3d::decimal*>(&modelMatrix));
+		modelMatrix = glm::scale(modelMatrix, glm::vec3(NormalizingScalingFactor * Sizes[index]));
+	}
+
+	// The asteroids are drawn without textures (cf. CAsteroid::CAsteroid).
+	Model->SubmitInstanced(Queue, Instances, true);
+}
+
+void CAsteroidPoolSoA::SwapSlots(uint32_t const IndexA, uint32_t const IndexB)
+{
+	if (IndexA == IndexB) return;
+	std::swap(PositionsX[IndexA], PositionsX[IndexB]);
+	std::swap(PositionsY[IndexA], PositionsY[IndexB]);
+	std::swap(PositionsZ[IndexA], PositionsZ[IndexB]);
+	std::swap(Orientations[IndexA], Orientations[IndexB]);
+	std::swap(Sizes[IndexA], Sizes[IndexB]);
+	std::swap(ActiveFlags[IndexA], ActiveFlags[IndexB]);
+	std::swap(RigidBodies[IndexA], RigidBodies[IndexB]);
+}
\ No newline at end of file
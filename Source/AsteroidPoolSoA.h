@@ -0,0 +1,55 @@
+#pragma once
+#include "Types.h"
+#include "Entity.h"
+#include "CollisionShapeCache.h"
+#include <reactphysics3d/reactphysics3d.h>
+
+// Structure-of-arrays alternative to CEntityPool<CAsteroid, ...>.
+// No CAsteroid objects (no vtable, no 64-byte model matrix per asteroid): every attribute lives in its own contiguous array.
+// The active asteroids are kept packed in [0, NumberOfActive) (swap with the last active one on despawn),
+// so that the per-frame loops are tight loops over contiguous memory.
+// Note: the rigid bodies have no user data, so these asteroids do not go through CEntity::OnCollision.
+class CAsteroidPoolSoA
+{
+public:
+	CAsteroidPoolSoA(uint32_t const Capacity, CModel* const Model = nullptr);
+
+	// Creates one (inactive) rigid body per slot, their spheres come from Shapes. Call before anything else.
+	void InitializeRigidBodies(CCollisionShapeCache& Shapes, rp3d::PhysicsWorld* const PhysicsWorld);
+	void DestroyRigidBodies(rp3d::PhysicsWorld* const PhysicsWorld);
+
+	// Same as CWorld::SpawnAsteroid: randomizes an inactive asteroid around the player and activates it.
+	// Returns false if the pool is full.
+	bool Spawn(CAsteroid::SParams const& Params = CAsteroid::SParams());
+
+	// Same as CAsteroid::Update on every active asteroid: despawn check, then interpolation of the transforms.
+	void UpdateAllActive(glm::vec3 const& ArwingPosition, float const InterpolationFactor);
+
+	void SubmitAllActive(CRenderQueue& Queue);
+
+	uint32_t GetCapacity() const { return Capacity; }
+	uint32_t GetNumberOfActive() const { return NumberOfActive; }
+
+private:
+	uint32_t const Capacity = 0;
+	uint32_t NumberOfActive = 0;
+
+	CModel* const Model = nullptr;
+	float NormalizingScalingFactor = 1.f;
+
+	// Asteroids despawn when they are this far from the Arwing.
+	float const DespawnDistance = 3000.f;
+
+	// One entry per slot, active ones first.
+	vector<float> PositionsX, PositionsY, PositionsZ;	// Last interpolated positions (in m).
+	vector<rp3d::Quaternion> Orientations;				// Last interpolated orientations.
+	vector<float> Sizes;								// In m.
+	vector<uint8_t> ActiveFlags;						// Written by the despawn test.
+	vector<rp3d::RigidBody*> RigidBodies;				// Resources managed by rp3d::PhysicsCommon.
+	CCollisionShapeCache* Shapes = nullptr;
+
+	// Kept between frames to avoid reallocations.
+	vector<SInstanceData> Instances;
+
+	void SwapSlots(uint32_t const IndexA, uint32_t const IndexB);
+};
\ No newline at end of file
@@ -0,0 +1,574 @@
+#include "Benchmark.h"
+#include "World.h"
+#include "AsteroidPoolSoA.h"
+#include "SpatialHashGrid.h"
+#include "Transform.h"
+
+using CClock = std::chrono::steady_clock;
+
+static double GetElapsedSeconds(CClock::time_point const StartTime)
+{
+	return std::chrono::duration<double>(CClock::now() - StartTime).count();
+}
+
+// Number of updates timed per measure.
+static int constexpr gIterations = 200;
+
+///////////////////////////			POOL (AoS vs SoA)			///////////////////////////////
+
+// Returns the average time of one UpdateAllActiveEntities on a full CEntityPool<CAsteroid, Size>, in s.
+template<uint32_t Size>
+static double BenchmarkAoSPool()
+{
+	// The entities need a world to get their rigid bodies, the Arwing position and the interpolation factor from.
+	std::unique_ptr<CWorld> world = std::make_unique<CWorld>(nullptr);
+	CModel model(ROOT_DIR"Resources\\Meshes\\Cube\\Cube.obj", true);
+
+	std::unique_ptr<CEntityPool<CAsteroid, Size>> pool = std::make_unique<CEntityPool<CAsteroid, Size>>();
+	pool->FillWith(CAsteroid(world.get(), &model));
+
+	CAsteroid::SParams params;
+	params.PlayerPosition = world->GetArwingPosition();
+	for (uint32_t k = 0; k < Size; k++) pool->GetInactiveEntity()->Randomize(params);
+	// A first step, so that the physics snapshot read by the updates has their bodies.
+	world->Update(1.f / 60.f);
+
+	CClock::time_point const startTime = CClock::now();
+	for (int k = 0; k < gIterations; k++) pool->UpdateAllActiveEntities(1.f / 60.f);
+	return GetElapsedSeconds(startTime) / gIterations;
+}
+
+// Same for CAsteroidPoolSoA.
+static double BenchmarkSoAPool(uint32_t const Size)
+{
+	rp3d::PhysicsCommon physicsCommon;
+	rp3d::PhysicsWorld* const physicsWorld = physicsCommon.createPhysicsWorld();
+	CModel model(ROOT_DIR"Resources\\Meshes\\Cube\\Cube.obj", true);
+
+	CCollisionShapeCache shapes(physicsCommon);
+	CAsteroidPoolSoA pool(Size, &model);
+	pool.InitializeRigidBodies(shapes, physicsWorld);
+	for (uint32_t k = 0; k < Size; k++) pool.Spawn();
+
+	CClock::time_point const startTime = CClock::now();
+	for (int k = 0; k < gIterations; k++) pool.UpdateAllActive(glm::vec3(0.f), 0.f);
+	double const res = GetElapsedSeconds(startTime) / gIterations;
+
+	pool.DestroyRigidBodies(physicsWorld);
+	return res;
+}
+
+static void ReportPool(uint32_t const Size, double const AoSTime, double const SoATime)
+{
+	ConsoleWrite(" -> %5u asteroids : AoS %8.3f ms (%6.1f ns/asteroid) | SoA %8.3f ms (%6.1f ns/asteroid) | x%.2f",
+		Size, 1e3 * AoSTime, 1e9 * AoSTime / Size, 1e3 * SoATime, 1e9 * SoATime / Size, AoSTime / SoATime);
+}
+
+static int BenchmarkPools()
+{
+	ConsoleWriteOk("Pool update (despawn test + transform interpolation), all asteroids active, %d iterations:", gIterations);
+	ReportPool(1000, BenchmarkAoSPool<1000>(), BenchmarkSoAPool(1000));
+	ReportPool(6000, BenchmarkAoSPool<6000>(), BenchmarkSoAPool(6000));
+	ReportPool(50000, BenchmarkAoSPool<50000>(), BenchmarkSoAPool(50000));
+	return 0;
+}
+
+///////////////////////////			PARALLEL POOL UPDATE			///////////////////////////////
+
+static int BenchmarkParallelUpdate()
+{
+	uint32_t constexpr Size = 50000;
+	std::unique_ptr<CWorld> world = std::make_unique<CWorld>(nullptr);
+	CModel model(ROOT_DIR"Resources\\Meshes\\Cube\\Cube.obj", true);
+
+	std::unique_ptr<CEntityPool<CAsteroid, Size>> pool = std::make_unique<CEntityPool<CAsteroid, Size>>();
+	pool->FillWith(CAsteroid(world.get(), &model));
+
+	CAsteroid::SParams params;
+	params.PlayerPosition = world->GetArwingPosition();
+	for (uint32_t k = 0; k < Size; k++) pool->GetInactiveEntity()->Randomize(params);
+	world->Update(1.f / 60.f); // Cf. BenchmarkAoSPool.
+
+	uint32_t const maxNumberOfThreads = std::max(1u, std::thread::hardware_concurrency());
+	ConsoleWriteOk("Parallel pool update, %u asteroids, %d iterations, up to %u threads:", Size, gIterations, maxNumberOfThreads);
+
+	double singleThreadTime = 0.;
+	for (uint32_t numberOfThreads = 1; numberOfThreads <= maxNumberOfThreads; numberOfThreads *= 2)
+	{
+		CJobSystem jobSystem(numberOfThreads);
+		CClock::time_point const startTime = CClock::now();
+		for (int k = 0; k < gIterations; k++) pool->UpdateAllActiveEntitiesParallel(1.f / 60.f, jobSystem);
+		double const time = GetElapsedSeconds(startTime) / gIterations;
+		if (numberOfThreads == 1) singleThreadTime = time;
+
+		ConsoleWrite(" -> %2u threads : %8.3f ms | speedup x%.2f | efficiency %3.0f%%",
+			numberOfThreads, 1e3 * time, singleThreadTime / time, 100. * singleThreadTime / time / numberOfThreads);
+		if (numberOfThreads < maxNumberOfThreads && 2 * numberOfThreads > maxNumberOfThreads) numberOfThreads = maxNumberOfThreads / 2;
+	}
+	return 0;
+}
+
+///////////////////////////			SPATIAL QUERIES			///////////////////////////////
+
+// Spheres spread like spawned asteroids (cf. CAsteroid::SParams) around the origin.
+struct SSpheres
+{
+	vector<glm::vec3> Positions;
+	vector<glm::vec3> Velocities;
+	vector<float> Radiuses;
+};
+
+static void RandomizeSpheres(SSpheres& Spheres, uint32_t const Count)
+{
+	CRandomizer r;
+	CAsteroid::SParams const params;
+	for (uint32_t k = 0; k < Count; k++)
+	{
+		glm::vec3 direction; r.GetRandomVector(direction);
+		Spheres.Positions.push_back(direction * r.GetRandomFloat(params.MinSpawnDistanceFromPlayer, params.MaxSpawnDistanceFromPlayer));
+		glm::vec3 velocity; r.GetRandomVector(velocity);
+		Spheres.Velocities.push_back(velocity * r.GetRandomFloat(params.MinLinearVelocity, params.MaxLinearVelocity));
+		Spheres.Radiuses.push_back(0.87f * r.GetRandomFloat(params.MinSize, params.MaxSize)); // Cube bounding sphere.
+	}
+}
+
+static void BenchmarkSpatialQueries(uint32_t const Count)
+{
+	int constexpr NumberOfQueries = 1000;
+	float constexpr QueryRadius = 500.f;
+	float constexpr RayLength = 3000.f;
+
+	SSpheres spheres; RandomizeSpheres(spheres, Count);
+	CSpatialHashGrid grid(400.f);
+	for (uint32_t k = 0; k < Count; k++) grid.Update(k, spheres.Positions[k], spheres.Radiuses[k]);
+
+	// Query origins and ray directions around the player (at the origin).
+	CRandomizer r;
+	vector<glm::vec3> origins, directions;
+	for (int k = 0; k < NumberOfQueries; k++)
+	{
+		glm::vec3 v; r.GetRandomVector(v); origins.push_back(v * r.GetRandomFloat(0.f, 200.f));
+		r.GetRandomVector(v); directions.push_back(v);
+	}
+
+	// Incremental update: every sphere moves by one frame.
+	CClock::time_point startTime = CClock::now();
+	for (int k = 0; k < gIterations; k++)
+	{
+		for (uint32_t i = 0; i < Count; i++)
+		{
+			spheres.Positions[i] += spheres.Velocities[i] * (1.f / 60.f);
+			grid.Update(i, spheres.Positions[i], spheres.Radiuses[i]);
+		}
+	}
+	double const updateTime = GetElapsedSeconds(startTime) / gIterations;
+
+	// Radius queries.
+	vector<uint32_t> ids;
+	size_t gridFound = 0, bruteFound = 0;
+	startTime = CClock::now();
+	for (glm::vec3 const& origin : origins) { ids.clear(); grid.QueryRadius(origin, QueryRadius, ids); gridFound += ids.size(); }
+	double const gridRadiusTime = GetElapsedSeconds(startTime) / NumberOfQueries;
+
+	startTime = CClock::now();
+	for (glm::vec3 const& origin : origins)
+	{
+		for (uint32_t i = 0; i < Count; i++)
+		{
+			float const distance = QueryRadius + spheres.Radiuses[i];
+			glm::vec3 const delta = spheres.Positions[i] - origin;
+			if (glm::dot(delta, delta) <= distance * distance) bruteFound++;
+		}
+	}
+	double const bruteRadiusTime = GetElapsedSeconds(startTime) / NumberOfQueries;
+	assert(gridFound == bruteFound);
+
+	// Ray queries.
+	uint32_t gridHits = 0, bruteHits = 0;
+	startTime = CClock::now();
+	for (int k = 0; k < NumberOfQueries; k++)
+	{
+		uint32_t id; float distance;
+		if (grid.Raycast(origins[k], directions[k], RayLength, id, distance)) gridHits++;
+	}
+	double const gridRayTime = GetElapsedSeconds(startTime) / NumberOfQueries;
+
+	startTime = CClock::now();
+	for (int k = 0; k < NumberOfQueries; k++)
+	{
+		bool hit = false;
+		for (uint32_t i = 0; i < Count; i++)
+		{
+			glm::vec3 const m = origins[k] - spheres.Positions[i];
+			float const b = glm::dot(m, directions[k]);
+			float const c = glm::dot(m, m) - spheres.Radiuses[i] * spheres.Radiuses[i];
+			if (c > 0.f && b > 0.f) continue;
+			float const discriminant = b * b - c;
+			if (discriminant >= 0.f && -b - std::sqrt(discriminant) <= RayLength) hit = true;
+		}
+		if (hit) bruteHits++;
+	}
+	double const bruteRayTime = GetElapsedSeconds(startTime) / NumberOfQueries;
+
+	ConsoleWrite(" -> %5u asteroids : update %6.1f ns/asteroid | radius grid %8.2f us, brute %8.2f us (x%.1f) | ray grid %8.2f us, brute %8.2f us (x%.1f) | hits %u/%u",
+		Count, 1e9 * updateTime / Count,
+		1e6 * gridRadiusTime, 1e6 * bruteRadiusTime, bruteRadiusTime / gridRadiusTime,
+		1e6 * gridRayTime, 1e6 * bruteRayTime, bruteRayTime / gridRayTime, gridHits, bruteHits);
+}
+
+static int BenchmarkSpatial()
+{
+	ConsoleWriteOk("Spatial hash grid vs brute force, 1000 queries (radius 500 m, rays 3000 m) around the player:");
+	BenchmarkSpatialQueries(1000);
+	BenchmarkSpatialQueries(6000);
+	BenchmarkSpatialQueries(50000);
+	return 0;
+}
+
+///////////////////////////			MODEL LOADING			///////////////////////////////
+
+// Average time of a CPU-only CModel::Load of Path, in s.
+static double BenchmarkModelLoad(char const* const Path)
+{
+	int constexpr NumberOfLoads = 5;
+	CClock::time_point const startTime = CClock::now();
+	for (int k = 0; k < NumberOfLoads; k++) { CModel model; model.Load(Path, true); }
+	return GetElapsedSeconds(startTime) / NumberOfLoads;
+}
+
+static int BenchmarkLoad()
+{
+	char const* const paths[] =
+	{
+		ROOT_DIR"Resources\\Meshes\\Arwing\\arwing_starlink.fbx",
+		ROOT_DIR"Resources\\Meshes\\Cube\\Cube.obj",
+		ROOT_DIR"Resources\\Meshes\\SpaceBox\\space.obj",
+	};
+	vector<double> assimpTimes, cacheTimes;
+
+	CModel::SetMeshCacheEnabled(false);
+	for (char const* const path : paths) assimpTimes.push_back(BenchmarkModelLoad(path));
+	CModel::SetMeshCacheEnabled(true);
+	for (char const* const path : paths) { CModel model; model.Load(path, true); } // Makes sure the caches are up to date.
+	for (char const* const path : paths) cacheTimes.push_back(BenchmarkModelLoad(path));
+
+	ConsoleWriteOk("Model loading (geometry only), Assimp import vs mesh cache:");
+	double assimpTotal = 0., cacheTotal = 0.;
+	for (size_t k = 0; k < assimpTimes.size(); k++)
+	{
+		ConsoleWrite(" -> %s : Assimp %8.2f ms | cache %8.2f ms | x%.1f", paths[k], 1e3 * assimpTimes[k], 1e3 * cacheTimes[k], assimpTimes[k] / cacheTimes[k]);
+		assimpTotal += assimpTimes[k]; cacheTotal += cacheTimes[k];
+	}
+	ConsoleWrite(" -> total : Assimp %8.2f ms | cache %8.2f ms | x%.1f", 1e3 * assimpTotal, 1e3 * cacheTotal, assimpTotal / cacheTotal);
+	return 0;
+}
+
+///////////////////////////			TRANSFORMS			///////////////////////////////
+
+// One frame of a moving entity: rotation and translation along its local axes, then the model and normal
+// matrices of its draw, for a model of NumberOfMeshes meshes.
+// Matrix path (what CEntity used to do): glm::mat4 rotated and translated in place, renormalized,
+// scaled, and one inverse-transpose per mesh.
+static double BenchmarkMatrixTransforms(vector<glm::mat4>& Matrices, vector<float> const& Scales, int const NumberOfMeshes, float& Sink)
+{
+	auto const normalize = [](glm::mat4& m) { m[0] = glm::normalize(m[0]); m[1] = glm::normalize(m[1]); m[2] = glm::normalize(m[2]); };
+
+	CClock::time_point const startTime = CClock::now();
+	for (int k = 0; k < gIterations; k++)
+	{
+		for (size_t i = 0; i < Matrices.size(); i++)
+		{
+			glm::mat4& matrix = Matrices[i];
+			matrix = glm::rotate(matrix, 0.01f, glm::vec3(0.f, 1.f, 0.f));
+			normalize(matrix);
+			matrix = glm::translate(matrix, glm::vec3(0.f, 0.f, 0.1f));
+
+			glm::mat4 const model = glm::scale(matrix, glm::vec3(Scales[i]));
+			for (int m = 0; m < NumberOfMeshes; m++)
+			{
+				glm::mat3 const normalMatrix = glm::mat3(glm::transpose(glm::inverse(model)));
+				Sink += model[3][0] + normalMatrix[1][1];
+			}
+		}
+	}
+	return GetElapsedSeconds(startTime) / gIterations;
+}
+
+// Same with STransform: the matrices are built once per entity, the normal matrix from the rotation.
+static double BenchmarkSTransforms(vector<STransform>& Transforms, vector<float> const& Scales, int const NumberOfMeshes, float& Sink)
+{
+	CClock::time_point const startTime = CClock::now();
+	for (int k = 0; k < gIterations; k++)
+	{
+		for (size_t i = 0; i < Transforms.size(); i++)
+		{
+			STransform& transform = Transforms[i];
+			transform.Rotate(0.01f, glm::vec3(0.f, 1.f, 0.f));
+			transform.Translate(glm::vec3(0.f, 0.f, 0.1f));
+
+			STransform const drawTransform = transform.Scaled(Scales[i]);
+			glm::mat4 const model = drawTransform.GetMatrix();
+			glm::mat3 const normalMatrix = drawTransform.GetNormalMatrix();
+			for (int m = 0; m < NumberOfMeshes; m++) Sink += model[3][0] + normalMatrix[1][1];
+		}
+	}
+	return GetElapsedSeconds(startTime) / gIterations;
+}
+
+static int BenchmarkTransforms()
+{
+	uint32_t constexpr Count = 10000;
+	CRandomizer r;
+	vector<glm::mat4> matrices(Count);
+	vector<STransform> transforms(Count);
+	vector<float> scales(Count);
+	for (uint32_t k = 0; k < Count; k++)
+	{
+		glm::vec3 axis; r.GetRandomVector(axis);
+		glm::vec3 position; r.GetRandomVector(position);
+		float const angle = glm::radians(r.GetRandomFloat(0.f, 360.f));
+		transforms[k].Translate(position * r.GetRandomFloat(0.f, 3000.f));
+		transforms[k].Rotate(angle, glm::normalize(axis));
+		matrices[k] = transforms[k].GetMatrix();
+		scales[k] = r.GetRandomFloat(8.f, 150.f);
+	}
+
+	ConsoleWriteOk("Transform pipeline (update + model and normal matrices), %u entities, %d iterations:", Count, gIterations);
+	float sink = 0.f;
+	for (int numberOfMeshes : { 1, 4 })
+	{
+		double const matrixTime = BenchmarkMatrixTransforms(matrices, scales, numberOfMeshes, sink);
+		double const transformTime = BenchmarkSTransforms(transforms, scales, numberOfMeshes, sink);
+		ConsoleWrite(" -> %d mesh(es) per model : glm::mat4 %8.3f ms (%6.1f ns/entity) | STransform %8.3f ms (%6.1f ns/entity) | x%.2f",
+			numberOfMeshes, 1e3 * matrixTime, 1e9 * matrixTime / Count, 1e3 * transformTime, 1e9 * transformTime / Count, matrixTime / transformTime);
+	}
+	// So that the work is not optimized away.
+	if (sink == 42.f) ConsoleWrite("%f", sink);
+	return 0;
+}
+
+///////////////////////////			COLLISION SHAPES			///////////////////////////////
+
+// Counts what rp3d allocates (its pools grow by pages, so this is the memory actually taken from the heap).
+class CCountingAllocator : public rp3d::MemoryAllocator
+{
+public:
+	virtual void* allocate(size_t Size) override { Bytes += Size; return std::malloc(Size); }
+	virtual void release(void* Pointer, size_t Size) override { Bytes -= Size; std::free(Pointer); }
+	size_t Bytes = 0;
+};
+
+struct SShapeBenchmarkResult
+{
+	double CreationTime = 0.;	// In s.
+	double RespawnTime = 0.;	// In s.
+	size_t Bytes = 0;
+	uint32_t NumberOfShapes = 0;
+};
+
+// Creates Count asteroid bodies, then gives each one a new random size (as a respawn does).
+// Without the cache, a sphere is created per body and replaced by a new one on respawn.
+static SShapeBenchmarkResult BenchmarkShapes(uint32_t const Count, bool const UseCache)
+{
+	SShapeBenchmarkResult result;
+	CCountingAllocator allocator;
+	{
+		rp3d::PhysicsCommon physicsCommon(&allocator);
+		rp3d::PhysicsWorld* const physicsWorld = physicsCommon.createPhysicsWorld();
+		CCollisionShapeCache shapes(physicsCommon);
+		CAsteroid::SParams const params;
+		CRandomizer r;
+		vector<rp3d::RigidBody*> bodies(Count);
+		size_t const bytesBefore = allocator.Bytes;
+
+		CClock::time_point startTime = CClock::now();
+		for (uint32_t k = 0; k < Count; k++)
+		{
+			bodies[k] = physicsWorld->createRigidBody(rp3d::Transform::identity());
+			float const size = r.GetRandomFloat(params.MinSize, params.MaxSize);
+			if (UseCache) shapes.SetSphere(bodies[k], size);
+			else bodies[k]->addCollider(physicsCommon.createSphereShape(size), rp3d::Transform::identity());
+		}
+		result.CreationTime = GetElapsedSeconds(startTime);
+		result.Bytes = allocator.Bytes - bytesBefore;
+
+		startTime = CClock::now();
+		for (uint32_t k = 0; k < Count; k++)
+		{
+			float const size = r.GetRandomFloat(params.MinSize, params.MaxSize);
+			if (UseCache) { shapes.SetSphere(bodies[k], size); continue; }
+			rp3d::Collider* const collider = bodies[k]->getCollider(0);
+			rp3d::SphereShape* const oldSphere = static_cast<rp3d::SphereShape*>(collider->getCollisionShape());
+			bodies[k]->removeCollider(collider);
+			physicsCommon.destroySphereShape(oldSphere);
+			bodies[k]->addCollider(physicsCommon.createSphereShape(size), rp3d::Transform::identity());
+		}
+		result.RespawnTime = GetElapsedSeconds(startTime);
+		result.NumberOfShapes = UseCache ? shapes.GetNumberOfShapes() : Count;
+	}
+	return result;
+}
+
+static int BenchmarkCollisionShapes()
+{
+	uint32_t constexpr Count = 50000;
+	SShapeBenchmarkResult const unique = BenchmarkShapes(Count, false);
+	SShapeBenchmarkResult const cached = BenchmarkShapes(Count, true);
+
+	ConsoleWriteOk("Collision shapes of a %u-asteroid pool, one sphere per body vs shared spheres (radius step 0.25 m):", Count);
+	ConsoleWrite(" -> shapes   : %8u | %8u", unique.NumberOfShapes, cached.NumberOfShapes);
+	ConsoleWrite(" -> memory   : %8.2f MB | %8.2f MB (bodies included) | x%.2f", unique.Bytes / 1048576., cached.Bytes / 1048576., double(unique.Bytes) / std::max<size_t>(cached.Bytes, 1));
+	ConsoleWrite(" -> creation : %8.2f ms | %8.2f ms | x%.2f", 1e3 * unique.CreationTime, 1e3 * cached.CreationTime, unique.CreationTime / cached.CreationTime);
+	ConsoleWrite(" -> respawn  : %8.2f ms | %8.2f ms | x%.2f", 1e3 * unique.RespawnTime, 1e3 * cached.RespawnTime, unique.RespawnTime / cached.RespawnTime);
+	return 0;
+}
+
+///////////////////////////			COLLISION LAYERS			///////////////////////////////
+
+// Estimate of the pairs of colliders handed to the narrow phase, which rp3d only counts in its profiler build:
+// overlapping AABBs (sort and sweep on x) accepted by the category and mask bits, with at least one body awake.
+// rp3d tests its fat AABBs, so it tests a few more.
+static uint32_t EstimateNarrowPhasePairs(rp3d::PhysicsWorld const& PhysicsWorld)
+{
+	struct SEntry { rp3d::AABB AABB; unsigned short Category, Mask; bool Awake; };
+	vector<SEntry> entries;
+	for (uint32_t k = 0; k < PhysicsWorld.getNbRigidBodies(); k++)
+	{
+		rp3d::RigidBody const* const body = PhysicsWorld.getRigidBody(k);
+		if (!body->isActive()) continue;
+		for (uint32_t c = 0; c < body->getNbColliders(); c++)
+		{
+			rp3d::Collider const* const collider = body->getCollider(c);
+			entries.push_back({ collider->getWorldAABB(), collider->getCollisionCategoryBits(), collider->getCollideWithMaskBits(), !body->isSleeping() });
+		}
+	}
+	std::sort(entries.begin(), entries.end(), [](SEntry const& A, SEntry const& B) { return A.AABB.getMin().x < B.AABB.getMin().x; });
+
+	uint32_t pairs = 0;
+	for (size_t a = 0; a < entries.size(); a++)
+	{
+		for (size_t b = a + 1; b < entries.size() && entries[b].AABB.getMin().x <= entries[a].AABB.getMax().x; b++)
+		{
+			SEntry const& A = entries[a]; SEntry const& B = entries[b];
+			if (!(A.Category & B.Mask) || !(B.Category & A.Mask) || (!A.Awake && !B.Awake)) continue;
+			if (A.AABB.testCollision(B.AABB)) pairs++;
+		}
+	}
+	return pairs;
+}
+
+static void BenchmarkCollisionLayers(bool const AsteroidSelfCollisions)
+{
+	int constexpr NumberOfFrames = 300;
+	SPhysicsSettings settings;
+	settings.AsteroidSelfCollisions = AsteroidSelfCollisions;
+	CWorld::SetPhysicsSettings(settings);
+
+	// Denser than in game: the whole pool is spawned at once.
+	std::unique_ptr<CWorld> world = std::make_unique<CWorld>(nullptr);
+	for (int k = 0; k < 6000; k++) world->SpawnAsteroid();
+
+	uint64_t narrowPhasePairs = 0, contactPairs = 0, substeps = 0;
+	double stepTime = 0.;
+	for (int frame = 0; frame < NumberOfFrames; frame++)
+	{
+		world->Update(1.f / 60.f);
+		SPhysicsStats const& stats = world->GetPhysicsStats();
+		substeps += stats.Substeps;
+		contactPairs += stats.ContactPairs;
+		stepTime += stats.StepTime;
+		narrowPhasePairs += uint64_t(EstimateNarrowPhasePairs(*world->GetPhysicsWorld())) * stats.Substeps;
+	}
+	substeps = std::max<uint64_t>(substeps, 1);
+	ConsoleWrite(" -> asteroid-asteroid pairs %-8s : %6.3f ms/step | %6.2f contact pairs/step | ~%8.1f narrow-phase pairs/step (estimate)",
+		AsteroidSelfCollisions ? "tested" : "rejected", stepTime / substeps, double(contactPairs) / substeps, double(narrowPhasePairs) / substeps);
+}
+
+static int BenchmarkPairs()
+{
+	ConsoleWriteOk("Physics pairs, 6000 asteroids, 300 frames (broad-phase AABB inflation %.0f%%, fixed in rp3d):", 100.f * SPhysicsSettings::FatAABBInflation);
+	ConsoleWrite("   step time and contact pairs measured by rp3d, narrow-phase pairs estimated from the world AABBs");
+	SPhysicsSettings const settings = CWorld::GetPhysicsSettings();
+	BenchmarkCollisionLayers(true);
+	BenchmarkCollisionLayers(false);
+	CWorld::SetPhysicsSettings(settings);
+	return 0;
+}
+
+///////////////////////////			FRAME STALLS			///////////////////////////////
+
+// A game loop fed with its own frame times (1/60 s at least, like a vsync), with a stall (window drag, slow load)
+// injected every StallPeriod frames. Threaded, the frame times are the game thread's only.
+static void BenchmarkStalls(char const* const Name, SSubstepSettings const& Substeps, EPhysicsThreading const Threading = EPhysicsThreading::Inline)
+{
+	int constexpr NumberOfFrames = 600, StallPeriod = 120;
+	float constexpr StallTime = 0.5f; // In s.
+	SPhysicsSettings settings;
+	settings.AsteroidSelfCollisions = true; // Heavier steps.
+	settings.Substeps = Substeps;
+	settings.Threading = Threading;
+	CWorld::SetPhysicsSettings(settings);
+
+	std::unique_ptr<CWorld> world = std::make_unique<CWorld>(nullptr);
+	for (int k = 0; k < 6000; k++) world->SpawnAsteroid();
+
+	double totalTime = 0., maxFrameTime = 0.;
+	uint32_t slowFrames = 0, substeps = 0, maxStepsBehind = 0;
+	float minTimeScale = 1.f, frameDt = 1.f / 60.f;
+	for (int frame = 0; frame < NumberOfFrames; frame++)
+	{
+		if (frame % StallPeriod == StallPeriod - 1) frameDt += StallTime;
+		CClock::time_point const startTime = CClock::now();
+		world->Update(frameDt);
+		double const frameTime = GetElapsedSeconds(startTime);
+
+		totalTime += frameTime;
+		maxFrameTime = std::max(maxFrameTime, frameTime);
+		if (frameTime > 2. / 60.) slowFrames++;
+		substeps += world->GetPhysicsStats().Substeps;
+		minTimeScale = std::min(minTimeScale, world->GetPhysicsStats().TimeScale);
+		maxStepsBehind = std::max(maxStepsBehind, world->GetPhysicsStats().StepsBehind);
+		frameDt = std::max(1.f / 60.f, float(frameTime));
+	}
+	ConsoleWrite(" -> %-16s: %6.2f ms/frame | worst %7.2f ms | %3u frames > 33 ms | %5u substeps | %6.3f s dropped | time scale >= %.2f | %2u steps behind at most",
+		Name, 1e3 * totalTime / NumberOfFrames, 1e3 * maxFrameTime, slowFrames, substeps, world->GetPhysicsStats().TotalDroppedTime, minTimeScale, maxStepsBehind);
+}
+
+static int BenchmarkSubsteps()
+{
+	ConsoleWriteOk("Substep scheduling, 6000 asteroids colliding, 600 frames, a 0.5 s stall every 120 frames:");
+	SPhysicsSettings const settings = CWorld::GetPhysicsSettings();
+
+	SSubstepSettings unbounded;
+	unbounded.MaxSubstepsPerFrame = 0;
+	unbounded.StepBudget = 0.f;
+	BenchmarkStalls("unbounded", unbounded);
+
+	SSubstepSettings bounded;
+	BenchmarkStalls("bounded", bounded);
+
+	SSubstepSettings dilated;
+	dilated.TimeDilation = true;
+	BenchmarkStalls("time dilation", dilated);
+
+	// Same limits, the steps on the physics thread: the backlog bounds them, not the budget.
+	BenchmarkStalls("threaded", bounded, EPhysicsThreading::Always);
+
+	CWorld::SetPhysicsSettings(settings);
+	return 0;
+}
+
+int RunBenchmark(string const& Name)
+{
+	if (Name == "pool") return BenchmarkPools();
+	if (Name == "parallel") return BenchmarkParallelUpdate();
+	if (Name == "spatial") return BenchmarkSpatial();
+	if (Name == "load") return BenchmarkLoad();
+	if (Name == "transform") return BenchmarkTransforms();
+	if (Name == "shapes") return BenchmarkCollisionShapes();
+	if (Name == "pairs") return BenchmarkPairs();
+	if (Name == "substeps") return BenchmarkSubsteps();
+
+	ConsoleWriteErr("RunBenchmark(%s) : unknown benchmark. Available: pool, parallel, spatial, load, transform, shapes, pairs, substeps.", Name.c_str());
+	return -1;
+}
\ No newline at end of file
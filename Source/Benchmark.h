@@ -0,0 +1,6 @@
+#pragma once
+#include "Types.h"
+
+// Micro-benchmarks of the simulation. They run headless (no window, no OpenGL).
+// Usage: StarFauxGL --bench <name>. Returns the process exit code.
+int RunBenchmark(string const& Name);
\ No newline at end of file
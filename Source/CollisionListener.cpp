@@ -1,21 +1,77 @@
 #include "CollisionListener.h"
-#include "Entity.h"
 
-// Dispatch actions on collisions of 2 objects.
+CCollisionListener::CCollisionListener()
+{
+    Events.reserve(256);
+}
+
+void CCollisionListener::SetHandler(EEntityType const TypeA, EEntityType const TypeB, FContactHandler const Handler)
+{
+    Handlers[int(TypeA)][int(TypeB)] = { Handler, false };
+    if (TypeA != TypeB) Handlers[int(TypeB)][int(TypeA)] = { Handler, true };
+}
+
+// Only records the contacts: the game reacts to them in Dispatch, once the steps are over.
 void CCollisionListener::onContact(const CollisionCallback::CallbackData& callbackData)
 {
     using namespace rp3d;
 
-    std::cout << "Collision!\n";
-
-    for (uint16_t p = 0; p < callbackData.getNbContactPairs(); p++)
+    NumberOfContactPairs += callbackData.getNbContactPairs();
+    for (uint32 p = 0; p < callbackData.getNbContactPairs(); p++)
     {
-        CollisionCallback::ContactPair contactPair = callbackData.getContactPair(p);
+        CollisionCallback::ContactPair const contactPair = callbackData.getContactPair(p);
+        // The exit events have no contact point, nobody reacts to them.
+        if (contactPair.getEventType() == CollisionCallback::ContactPair::EventType::ContactExit) continue;
+
+        CEntity* const entityA = static_cast<CEntity*>(contactPair.getBody1()->getUserData());
+        CEntity* const entityB = static_cast<CEntity*>(contactPair.getBody2()->getUserData());
+        if (!entityA || !entityB) continue; // Bodies of no entity (cf. CAsteroidPoolSoA).
+
+        SContactEvent event;
+        event.HandleA = entityA->GetContactHandle();
+        event.HandleB = entityB->GetContactHandle();
+        event.TypeA = entityA->GetType();
+        event.TypeB = entityB->GetType();
+        if (!Handlers[int(event.TypeA)][int(event.TypeB)].Function) continue;
 
-        CEntity& entity1 = *(CEntity*)contactPair.getBody1()->getUserData();
-        CEntity& entity2 = *(CEntity*)contactPair.getBody2()->getUserData();
+        // Deepest contact point.
+        Vector3 point(0.f, 0.f, 0.f), normal(0.f, 0.f, 0.f);
+        decimal depth = -1.f;
+        for (uint32 c = 0; c < contactPair.getNbContactPoints(); c++)
+        {
+            CollisionCallback::ContactPoint const contactPoint = contactPair.getContactPoint(c);
+            if (contactPoint.getPenetrationDepth() <= depth) continue;
+            depth = contactPoint.getPenetrationDepth();
+            point = contactPair.getCollider1()->getLocalToWorldTransform() * contactPoint.getLocalPointOnCollider1();
+            normal = contactPoint.getWorldNormal();
+        }
+        event.ContactPoint = glm::vec3(point.x, point.y, point.z);
+        event.Normal = glm::vec3(normal.x, normal.y, normal.z);
+
+        // Kinematic and static bodies count as infinitely heavy.
+        RigidBody const* const bodyA = static_cast<RigidBody const*>(contactPair.getBody1());
+        RigidBody const* const bodyB = static_cast<RigidBody const*>(contactPair.getBody2());
+        decimal const inverseMassA = bodyA->getType() == BodyType::DYNAMIC && bodyA->getMass() > 0.f ? 1.f / bodyA->getMass() : 0.f;
+        decimal const inverseMassB = bodyB->getType() == BodyType::DYNAMIC && bodyB->getMass() > 0.f ? 1.f / bodyB->getMass() : 0.f;
+        decimal const approachSpeed = std::abs((bodyB->getLinearVelocity() - bodyA->getLinearVelocity()).dot(normal));
+        event.Impulse = inverseMassA + inverseMassB > 0.f ? float(approachSpeed / (inverseMassA + inverseMassB)) : 0.f;
+
+        Events.push_back(event);
+    }
+}
+
+void CCollisionListener::Dispatch(vector<SContactEvent> const& EventsToHandle) const
+{
+    assert(EntityResolver);
+    for (SContactEvent const& event : EventsToHandle)
+    {
+        // The steps may be a frame ahead of the game: the entities may have despawned (and respawned) meanwhile.
+        CEntity* const entityA = EntityResolver(event.TypeA, event.HandleA);
+        CEntity* const entityB = EntityResolver(event.TypeB, event.HandleB);
+        if (!entityA || !entityB) continue;
 
-        entity1.OnCollision(entity2);
-        entity2.OnCollision(entity1);
+        SHandler const& handler = Handlers[int(event.TypeA)][int(event.TypeB)];
+        if (handler.Swapped) handler.Function(*entityB, *entityA, event);
+        else handler.Function(*entityA, *entityB, event);
     }
 }
\ No newline at end of file
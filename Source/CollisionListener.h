@@ -1,8 +1,63 @@
 #pragma once
+#include "Types.h"
+#include "Entity.h"
 #include <reactphysics3d/reactphysics3d.h>
 
+// A contact pair reported during a physics step (POD), handled by the game thread after the step
+// (cf. CCollisionListener::Dispatch).
+struct SContactEvent
+{
+    // Handles of the entities when the contact happened (cf. CEntity::GetContactHandle): Dispatch drops the events of
+    // the entities released or respawned since. The Arwing is not pooled: the default handle is its fixed id.
+    SEntityHandle HandleA;
+    SEntityHandle HandleB;
+    EEntityType TypeA;
+    EEntityType TypeB;
+    // rp3d doesn't report the contact impulses: estimated as the reduced mass times the approach speed along the normal.
+    float Impulse;
+    glm::vec3 ContactPoint; // World space, deepest contact point of the pair.
+    glm::vec3 Normal;       // World space, from A to B.
+};
+
+// Called with A of the first type and B of the second type of the pair it is registered for
+// (Event is left as reported: its HandleA may be B's).
+using FContactHandler = void (*)(CEntity& A, CEntity& B, SContactEvent const& Event);
+// The entity a handle of an event refers to, nullptr if it is no longer the one the contact was reported for.
+using FEntityResolver = std::function<CEntity*(EEntityType const Type, SEntityHandle const& Handle)>;
+
+// Buffers the contacts reported by rp3d from inside PhysicsWorld::update (no virtual call, no RTTI, no output there),
+// they are then dispatched in one batch per type pair handler.
+// onContact is called on the thread stepping the world, which hands the events over to the game thread
+// (cf. CPhysicsThread): Dispatch only reads the handlers and the resolver, set before the world is first stepped.
 class CCollisionListener : public rp3d::EventListener
 {
 public:
+    CCollisionListener();
+
     virtual void onContact(const CollisionCallback::CallbackData& callbackData) override;
+
+    // Same handler for (TypeA, TypeB) and (TypeB, TypeA), the entities being swapped for the latter.
+    void SetHandler(EEntityType const TypeA, EEntityType const TypeB, FContactHandler const Handler);
+    void SetEntityResolver(FEntityResolver&& Resolver) { EntityResolver = std::move(Resolver); }
+    // Skips the events whose entities do not resolve anymore.
+    void Dispatch(vector<SContactEvent> const& EventsToHandle) const;
+
+    // Thread stepping the world: the events buffered since it last cleared them.
+    vector<SContactEvent>& GetEvents() { return Events; }
+
+    // Contact pairs reported since the last reset.
+    uint32_t GetNumberOfContactPairs() const { return NumberOfContactPairs; }
+    void ResetCounters() { NumberOfContactPairs = 0; }
+
+private:
+    struct SHandler
+    {
+        FContactHandler Function = nullptr;
+        bool Swapped = false;
+    };
+    SHandler Handlers[int(EEntityType::EnumCount)][int(EEntityType::EnumCount)];
+    FEntityResolver EntityResolver;
+
+    vector<SContactEvent> Events; // Keeps its capacity between steps.
+    uint32_t NumberOfContactPairs = 0;
 };
\ No newline at end of file
@@ -0,0 +1,35 @@
+#include "CollisionShapeCache.h"
+
+CCollisionShapeCache::CCollisionShapeCache(rp3d::PhysicsCommon& PhysicsCommon, float const RadiusStep) :
+	PhysicsCommon(PhysicsCommon),
+	RadiusStep(RadiusStep)
+{
+	assert(RadiusStep > 0.f);
+}
+
+rp3d::SphereShape* CCollisionShapeCache::GetSphere(float const Radius)
+{
+	NumberOfRequests++;
+	uint32_t const key = GetRadiusKey(Radius);
+	rp3d::SphereShape*& sphere = Spheres[key];
+	if (!sphere) sphere = PhysicsCommon.createSphereShape(RadiusStep * float(key));
+	return sphere;
+}
+
+void CCollisionShapeCache::SetSphere(rp3d::RigidBody* const RigidBody, float const Radius)
+{
+	assert(RigidBody);
+	rp3d::SphereShape* const sphere = GetSphere(Radius);
+	unsigned short category = 0x0001, mask = 0xFFFF; // rp3d defaults.
+	if (RigidBody->getNbColliders() > 0)
+	{
+		rp3d::Collider* const collider = RigidBody->getCollider(0);
+		if (collider->getCollisionShape() == sphere) return;
+		category = collider->getCollisionCategoryBits();
+		mask = collider->getCollideWithMaskBits();
+		RigidBody->removeCollider(collider);
+	}
+	rp3d::Collider* const collider = RigidBody->addCollider(sphere, rp3d::Transform::identity());
+	collider->setCollisionCategoryBits(category);
+	collider->setCollideWithMaskBits(mask);
+}
\ No newline at end of file
@@ -0,0 +1,35 @@
+#pragma once
+#include "Types.h"
+#include <reactphysics3d/reactphysics3d.h>
+
+// Collision shapes shared by the rigid bodies. rp3d shapes can't be scaled per body, so the spheres are
+// keyed by their radius quantized to RadiusStep: a pool of asteroids only creates as many shapes as there
+// are distinct quantized sizes, instead of one per body (used by the thread stepping the world once it runs).
+// The shapes are owned by rp3d::PhysicsCommon: removing a collider or destroying a body does not free its shape,
+// they all live until the PhysicsCommon is destroyed (the cache never releases any, the number of sizes is bounded).
+class CCollisionShapeCache
+{
+public:
+	CCollisionShapeCache(rp3d::PhysicsCommon& PhysicsCommon, float const RadiusStep = 0.25f);
+
+	rp3d::SphereShape* GetSphere(float const Radius);
+	// Radius of the sphere GetSphere(Radius) returns (in m).
+	float GetQuantizedRadius(float const Radius) const { return RadiusStep * float(GetRadiusKey(Radius)); }
+
+	// Gives the body the sphere of radius Radius, replacing the one of its first collider if it differs
+	// (the collision category and mask of the replaced collider are kept).
+	void SetSphere(rp3d::RigidBody* const RigidBody, float const Radius);
+
+	uint32_t GetNumberOfShapes() const { return uint32_t(Spheres.size()); }
+	uint32_t GetNumberOfRequests() const { return NumberOfRequests; }
+
+private:
+	rp3d::PhysicsCommon& PhysicsCommon;
+	float const RadiusStep = 0.25f; // In m.
+
+	// By radius in steps (at least 1).
+	unordered_map<uint32_t, rp3d::SphereShape*> Spheres;
+	uint32_t NumberOfRequests = 0;
+
+	uint32_t GetRadiusKey(float const Radius) const { return std::max(1u, uint32_t(Radius / RadiusStep + 0.5f)); }
+};
\ No newline at end of file
@@ -32,56 +32,70 @@ void CEntity::DestroyRigidBody(rp3d::PhysicsWorld* const PhysicsWorld)
 }
 
 EEntityType CEntity::GetType() const { return Type; }
-glm::vec3 CEntity::GetPosition() const { return glm::vec3(ModelMatrix[3]); }
 
-void CEntity::Draw(glm::vec3 const& CameraPosition, glm::mat4 const& ViewMatrix, glm::mat4 const& ProjectionMatrix, glm::vec3 const& LightPosition, glm::vec3 const& LightColor)
+uint16_t CEntity::GetCollideWithMask(ECollisionLayer const Layer)
+{
+	switch (Layer)
+	{
+	case CL_Arwing: return CL_Asteroid;
+	case CL_Laser: return CL_Asteroid;
+	case CL_Asteroid: return CL_Arwing | CL_Laser | (CWorld::GetPhysicsSettings().AsteroidSelfCollisions ? CL_Asteroid : CL_None);
+	default: return CL_None;
+	}
+}
+
+void CEntity::ApplyCollisionLayer()
+{
+	if (!RigidBody) return;
+	uint16_t const mask = GetCollideWithMask();
+	for (uint32_t k = 0; k < RigidBody->getNbColliders(); k++)
+	{
+		rp3d::Collider* const collider = RigidBody->getCollider(k);
+		collider->setCollisionCategoryBits(GetCollisionLayer());
+		collider->setCollideWithMaskBits(mask);
+	}
+}
+glm::vec3 CEntity::GetPosition() const { return Transform.Translation; }
+
+void CEntity::Submit(CRenderQueue& Queue, glm::vec3 const& CameraPosition, glm::mat4 const& ProjectionMatrix)
 {
 	if (!Active) return;
 	if (!Model) return;
 
-	ResetScale();
-	ModelMatrix = glm::scale(ModelMatrix, glm::vec3(NormalizingScalingFactor * Size));
-	Model->Draw(CameraPosition, ModelMatrix, ViewMatrix, ProjectionMatrix, LightPosition, LightColor, !DrawTextures);
-	ResetScale();
+	STransform const drawTransform = GetDrawTransform();
+	Model->Submit(Queue, drawTransform.GetMatrix(), drawTransform.GetNormalMatrix(), !DrawTextures, SelectLod(CameraPosition, ProjectionMatrix));
 }
 
-void CEntity::SetActive(bool const IsActive)
+float CEntity::GetBoundingRadius() const
 {
-	Active = IsActive; if (RigidBody) RigidBody->setIsActive(IsActive);
+	if (!Model) return Size;
+	return Model->GetAABB().GetBoundingRadius() * NormalizingScalingFactor * Size;
 }
 
-bool CEntity::IsActive() const { return Active; }
-
-void CEntity::ResetScale()
+uint32_t CEntity::SelectLod(glm::vec3 const& CameraPosition, glm::mat4 const& ProjectionMatrix) const
 {
-	glm::vec4& x = ModelMatrix[0];
-	glm::vec4& y = ModelMatrix[1];
-	glm::vec4& z = ModelMatrix[2];
-	// Meh... float exact comparision...
-	assert(x.w == 0.f && y.w == 0.f && z.w == 0.f);
-	
-	float const xLength = glm::length(x);
-	float const yLength = glm::length(y);
-	float const zLength = glm::length(z);
-	assert(xLength >= 0.f && yLength >= 0.f && zLength >= 0.f);
+	if (!Model || Model->GetNumberOfLods() == 1) return 0;
+	// Distance to the closest point of the bounding sphere, so that the lod does not pop when getting close.
+	float const distance = glm::length(GetPosition() - CameraPosition) - GetBoundingRadius();
+	// The lod errors are in model units: scaling them the same way as the model.
+	float const pixelsPerModelUnit = CModel::GetPixelsPerUnit(distance, ProjectionMatrix) * NormalizingScalingFactor * Size;
+	return Model->SelectLod(pixelsPerModelUnit);
+}
 
-	x /= xLength; y /= yLength; z /= zLength;
+void CEntity::SetActive(bool const IsActive)
+{
+	Active = IsActive; if (!RigidBody) return;
+	rp3d::RigidBody* const body = RigidBody;
+	World->ExecuteOnPhysics([body, IsActive]() { body->setIsActive(IsActive); });
 }
 
-void CEntity::UpdateModelMatrixFromRigidBody(float const InterpolationFactor)
+bool CEntity::IsActive() const { return Active; }
+
+void CEntity::UpdateTransformFromPhysics(SPhysicsSnapshot const& Snapshot, float const InterpolationFactor)
 {
-	using namespace rp3d;
-	if (!RigidBody) return;
-	Transform newTransform = Transform::interpolateTransforms(RigidBody->getTransform(), PreviousTransform, InterpolationFactor);
-	newTransform.getOpenGLMatrix(reinterpret_cast<decimal*>(&ModelMatrix));
-	PreviousTransform = newTransform;
-
-	// The returned matrix shouldn't have any scaling info.
-	glm::vec4 x = ModelMatrix[0];
-	glm::vec4 y = ModelMatrix[1];
-	glm::vec4 z = ModelMatrix[2];
-	assert(x.w == 0.f && y.w == 0.f && z.w == 0.f);
-	// assert(glm::length(x) == 1.f && glm::length(y) == 1.f && glm::length(z) == 1.f);
+	if (PhysicsSlot >= Snapshot.Bodies.size() || Snapshot.StepIndex <= PhysicsTeleportStep) return;
+	SPhysicsSnapshot::SBody const& body = Snapshot.Bodies[PhysicsSlot];
+	Transform.SetFromPhysics(rp3d::Transform::interpolateTransforms(body.Previous, body.Current, InterpolationFactor));
 }
 
 CEntity& CEntity::operator=(CEntity const& Other)
@@ -103,11 +117,11 @@ CEntity& CEntity::operator=(CEntity const& Other)
 		return *this;
 	}
 	Active = Other.Active;
-	PreviousTransform = Other.PreviousTransform;
+	PhysicsTeleportStep = Other.PhysicsTeleportStep;
 	NormalizingScalingFactor = Other.NormalizingScalingFactor;
 	Hp = Other.Hp;
 	Model = Other.Model;
-	ModelMatrix = Other.ModelMatrix;
+	Transform = Other.Transform;
 	// RigidBody = Other.RigidBody; oof noooo don't do this!!
 	Size = Other.Size;
 	DrawTextures = Other.DrawTextures;
@@ -125,14 +139,14 @@ CAsteroid::CAsteroid(CWorld* const World, CModel* Model) : CEntity(World, EEntit
 }
 
 // !! Call Randomize before this to get the right size! !!
-void CAsteroid::InitializeRigidBody(rp3d::PhysicsCommon& PhysicsCommon, rp3d::PhysicsWorld* const PhysicsWorld)
+void CAsteroid::InitializeRigidBody(rp3d::PhysicsCommon&, rp3d::PhysicsWorld* const PhysicsWorld)
 {
 	using namespace rp3d;
-	Transform transform; transform.setFromOpenGL(reinterpret_cast<decimal*>(&ModelMatrix));
-	RigidBody = PhysicsWorld->createRigidBody(transform);
+	RigidBody = PhysicsWorld->createRigidBody(Transform.ToPhysics());
 
-	SphereShape* const sphere = PhysicsCommon.createSphereShape(Size);
-	RigidBody->addCollider(sphere, Transform::identity());
+	// Shared with the other asteroids of about the same size (a pool would otherwise create one per copy).
+	World->GetCollisionShapes().SetSphere(RigidBody, Size);
+	ApplyCollisionLayer();
 
 	RigidBody->setLinearDamping(0.f);
 	RigidBody->setAngularDamping(0.f);
@@ -144,23 +158,18 @@ void CAsteroid::InitializeRigidBody(rp3d::PhysicsCommon& PhysicsCommon, rp3d::Ph
 void CAsteroid::Update(float const Dt)
 {
 	// Despawn.
-	if (glm::length(World->GetArwingPosition() - GetPosition()) >= DespawnDistance) SetActive(false);
+	if (glm::length(World->GetArwingPosition() - GetPosition()) >= DespawnDistance) { MarkInactive(); return; }
 
-	UpdateModelMatrixFromRigidBody(World->GetInterpolationFactor());
+	UpdateTransformFromPhysics(World->GetPhysicsSnapshot(), World->GetInterpolationFactor());
 }
 
-void CAsteroid::OnCollision(CEntity const& CollidedWith)
+void CAsteroid::OnArwingCollision(CArwing const& Arwing)
 {
-	EEntityType type = CollidedWith.GetType();
-	if (type != EEntityType::Arwing) return;
-
-	CArwing const* arwing = dynamic_cast<CArwing const*>(&CollidedWith);
-	assert(arwing);
-
 	// Bon, a a t fait un peu  l'arrache...
-	glm::vec3 const& temp = arwing->GetForwardAxis();
+	glm::vec3 const temp = Arwing.GetForwardAxis();
 	rp3d::Vector3 const arwingForwardAxis(temp.x, temp.y, temp.z);
-	RigidBody->setLinearVelocity(600.f * arwingForwardAxis); // Bumps the hit asteroid forward!
+	rp3d::RigidBody* const body = RigidBody;
+	World->ExecuteOnPhysics([body, arwingForwardAxis]() { body->setLinearVelocity(600.f * arwingForwardAxis); }); // Bumps the hit asteroid forward!
 }
 
 void CAsteroid::Randomize(SParams const& Params)
@@ -175,17 +184,17 @@ void CAsteroid::Randomize(SParams const& Params)
 	CRandomizer r;
 
 	// Randomizes initial position
-	ModelMatrix = glm::mat4(1.f);
-	ModelMatrix = glm::translate(ModelMatrix, Params.PlayerPosition);
+	Transform = STransform();
+	Transform.Translate(Params.PlayerPosition);
 
 	glm::vec3 randomDirection; r.GetRandomVector(randomDirection);
 	float const randomDistance = r.GetRandomFloat(Params.MinSpawnDistanceFromPlayer, Params.MaxSpawnDistanceFromPlayer);
-	ModelMatrix = glm::translate(ModelMatrix, randomDistance * randomDirection);
+	Transform.Translate(randomDistance * randomDirection);
 
 	// Randomizes initial transform.
 	glm::vec3 randomRotationAxis; r.GetRandomVector(randomRotationAxis);
 	float const randomRotationAngle = glm::radians(r.GetRandomFloat(0.f, 360.f));
-	ModelMatrix = glm::rotate(ModelMatrix, randomRotationAngle, randomRotationAxis);
+	Transform.Rotate(randomRotationAngle, glm::normalize(randomRotationAxis));
 
 	// Randomizes size and mass.
 	Size = r.GetRandomFloat(Params.MinSize, Params.MaxSize);
@@ -198,13 +207,22 @@ void CAsteroid::Randomize(SParams const& Params)
 	r.GetRandomVector(AngularVelocity);
 	AngularVelocity *= r.GetRandomFloat(Params.MinAngularVelocity, Params.MaxAngularVelocity);
 
-	// Applying transforms to the rigid body.
+	// Applying transforms and size to the rigid body.
 	if (!RigidBody) return;
-	rp3d::Transform transform; transform.setFromOpenGL(reinterpret_cast<rp3d::decimal*>(&ModelMatrix));
-	RigidBody->setTransform(transform);
-
-	RigidBody->setLinearVelocity(LinearVelocity);
-	RigidBody->setAngularVelocity(AngularVelocity);
-
-	RigidBody->setMass(Mass);
+	PhysicsTeleportStep = World->GetPhysicsStepsRequested();
+	rp3d::RigidBody* const body = RigidBody;
+	CCollisionShapeCache* const shapes = &World->GetCollisionShapes();
+	rp3d::Transform const transform = Transform.ToPhysics();
+	float const size = Size, mass = Mass;
+	rp3d::Vector3 const linearVelocity = LinearVelocity, angularVelocity = AngularVelocity;
+	World->ExecuteOnPhysics([=]()
+		{
+			body->setTransform(transform);
+			shapes->SetSphere(body, size);
+
+			body->setLinearVelocity(linearVelocity);
+			body->setAngularVelocity(angularVelocity);
+
+			body->setMass(mass);
+		});
 }
\ No newline at end of file
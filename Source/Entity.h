@@ -1,13 +1,35 @@
 #pragma once
 #include "Types.h"
 #include "Model.h"
+#include "Transform.h"
 #include <reactphysics3d/reactphysics3d.h> 
 
 class CWorld;
+class CArwing;
+struct SPhysicsSnapshot;
 
 enum class EEntityType : uint8_t { Arwing = 0, Asteroid, Laser, Unknown, EnumCount };
 static constexpr char const* s_EntityNames[int(EEntityType::EnumCount)] = {"Arwing", "Asteroid", "Laser", "Unknown"};
 
+// Collision categories of the rigid bodies (rp3d category bits). Two bodies are only tested by the narrow phase
+// if each one's category is in the other's collide-with mask (cf. CEntity::GetCollideWithMask).
+enum ECollisionLayer : uint16_t
+{
+	CL_None		= 0, // Never collides.
+	CL_Arwing	= 1,
+	CL_Asteroid	= 2,
+	CL_Laser	= 4
+};
+static constexpr ECollisionLayer s_CollisionLayers[int(EEntityType::EnumCount)] = {CL_Arwing, CL_Asteroid, CL_Laser, CL_None};
+
+// Stable reference to an entity of a pool. Stays valid while the entity remains active:
+// once the entity is deactivated (and possibly reused), CEntityPool::Get returns nullptr for it.
+struct SEntityHandle
+{
+	uint32_t Index = uint32_t(-1);
+	uint32_t Generation = 0;
+};
+
 // Generic game entity class (entity-component stuff).
 class CEntity
 {
@@ -19,25 +41,52 @@ public:
 	void DestroyRigidBody(rp3d::PhysicsWorld* const);
 
 	EEntityType GetType() const;
+	ECollisionLayer GetCollisionLayer() const { return s_CollisionLayers[int(Type)]; }
+	// The layers this entity's rigid body collides with: the Arwing and the lasers only care about the asteroids.
+	uint16_t GetCollideWithMask() const { return GetCollideWithMask(GetCollisionLayer()); }
+	static uint16_t GetCollideWithMask(ECollisionLayer const Layer);
 	glm::vec3 GetPosition() const;
-
+	CModel* GetModel() const { return Model; }
+	bool IsDrawnWithTextures() const { return DrawTextures; }
+	// The transform scaled to the size of the entity, as drawn by Submit.
+	STransform GetDrawTransform() const { return Transform.Scaled(NormalizingScalingFactor * Size); }
+	// Its matrix (used by the instanced draw path).
+	glm::mat4 GetDrawModelMatrix() const { return GetDrawTransform().GetMatrix(); }
+	// Radius of a sphere centered on GetPosition() containing the drawn model (used for frustum culling).
+	float GetBoundingRadius() const;
+	// Level of detail of the model to draw, from the screen-space error at the current distance to the camera.
+	uint32_t SelectLod(glm::vec3 const& CameraPosition, glm::mat4 const& ProjectionMatrix) const;
+
+	// Pooled entities may be updated from worker threads (cf. CEntityPool::UpdateAllActiveEntitiesParallel):
+	// Update must only modify the entity itself, and not touch the rigid body (the physics may be stepping it).
 	virtual void Update(float const Dt) = 0;
-	void Draw(glm::vec3 const& CameraPosition, glm::mat4 const& ViewMatrix, glm::mat4 const& ProjectionMatrix, glm::vec3 const& LightPosition, glm::vec3 const& LightColor);
+	// Queues the draw of the model (the camera position and projection select its lod).
+	// The model and normal matrices are computed once for all the meshes.
+	void Submit(CRenderQueue& Queue, glm::vec3 const& CameraPosition, glm::mat4 const& ProjectionMatrix);
 
 	void SetActive(bool const IsActive);
 	bool IsActive() const;
 
-	virtual void OnCollision(CEntity const& CollidedWith) {};
+	// Interpolates between the transforms of the rigid body before and after the last step of the snapshot.
+	// Does nothing if the snapshot was taken before the last teleport of the body (cf. PhysicsTeleportStep).
+	void UpdateTransformFromPhysics(SPhysicsSnapshot const& Snapshot, float const InterpolationFactor);
 
-	// Could be defined only in classes that always have a rigid body to avoid checking that RigidBody != nullptr all the time.
-	void UpdateModelMatrixFromRigidBody(float const InterpolationFactor);
+	rp3d::RigidBody* GetRigidBody() const { return RigidBody; }
+	// Slot of the rigid body in the physics snapshots (cf. CWorld::InitializeRigidBody).
+	uint32_t GetPhysicsSlot() const { return PhysicsSlot; }
+	void SetPhysicsSlot(uint32_t const Slot) { PhysicsSlot = Slot; }
+	// Handle the contacts of the rigid body are reported with (cf. SContactEvent). Physics thread only: pooled entities
+	// get theirs through a command when they spawn (cf. CWorld::SpawnAsteroid), the Arwing keeps the default one.
+	SEntityHandle const& GetContactHandle() const { return ContactHandle; }
+	void SetContactHandle(SEntityHandle const& Handle) { ContactHandle = Handle; }
 
 private:
 	// Inactive entities are neither updated, nor physically simulated, nor rendered.
 	bool Active = true;
 	EEntityType const Type = EEntityType::Unknown;
 
-	rp3d::Transform PreviousTransform = rp3d::Transform::identity();
+	uint32_t PhysicsSlot = ~0u;
+	SEntityHandle ContactHandle;
 
 protected:
 	// The world the entity belongs to.
@@ -48,16 +97,26 @@ protected:
 	// The entity has no ownership over its model.
 	// Do not call delete on this pointer within CEntity or its derived classes.
 	CModel* Model = nullptr;
-	glm::mat4 ModelMatrix = glm::mat4(1.f);
+	// Unscaled: the size of the entity is only applied when drawing (cf. GetDrawTransform).
+	STransform Transform;
 	// Resource managed by rp3d::PhysicsCommon. Do not call delete on this pointer!!
+	// Stepped by the physics thread: changes to it go through CWorld::ExecuteOnPhysics once the world is running.
 	rp3d::RigidBody* RigidBody = nullptr;
+	// Physics steps requested when the rigid body was last moved by the game: the snapshots taken before that
+	// still have it at its previous place.
+	uint64_t PhysicsTeleportStep = 0;
 
 	float NormalizingScalingFactor = 1.f;
 	float Size = 1.f; // In m.
 
 	bool DrawTextures = true;
 
-	void ResetScale(); // Normalizes the model matrix's orientation vectors.
+	// Sets the collision layer and mask on the colliders of the rigid body. Call once the colliders are added.
+	void ApplyCollisionLayer();
+
+	// Deactivates the entity without touching its rigid body, so that it can be called from Update.
+	// The pool the entity belongs to then calls SetActive(false) from the main thread.
+	void MarkInactive() { Active = false; }
 
 public:
 	// Should this really be virtual?
@@ -73,7 +132,8 @@ public:
 
 	virtual void Update(float const Dt) override;
 
-	virtual void OnCollision(CEntity const& CollidedWith) override;
+	// Contact handler (cf. CWorld::CWorld).
+	void OnArwingCollision(CArwing const& Arwing);
 
 	struct SParams
 	{
@@ -5,7 +5,7 @@
 
 // Copy assignment operator for EntityType has to be defined in order to fill in the pool.
 // Otherwise, it won't compile...
-template<typename EntityType, uint16_t Size>
+template<typename EntityType, uint32_t Size>
 class CEntityPool
 {
 	static_assert(std::is_base_of<CEntity, EntityType>::value);
@@ -16,7 +16,10 @@ public:
 		// Little trick to avoid resorting to any kind of EntityType constructor.
 		Entities = reinterpret_cast<EntityType*>(new uint8_t[MaxNumberOfEntities * sizeof(EntityType)]);
 		NumberOfEntities = 0;
-		InactiveEntityIndexes[0] = 0;
+		InactiveEntityIndexes.resize(Size, 0);
+		ActiveEntityIndexes.reserve(Size);
+		PositionsInActiveList.resize(Size, InvalidPosition);
+		Generations.resize(Size, 0);
 	}
 	CEntityPool(EntityType const& Entity) : CEntityPool() { FillWith(Entity); }
 	~CEntityPool() { delete Entities; }
@@ -45,11 +48,11 @@ public:
 
 		NumberOfEntities++;
 		NumberOfInactiveEntities++;
-		assert(NumberOfEntities <= NumberOfEntities);
+		assert(NumberOfEntities <= MaxNumberOfEntities);
 	}
 	void FillWith(EntityType const& Entity)
 	{
-		for (uint16_t index = 0; index < MaxNumberOfEntities; index++) AddEntity(Entity);
+		for (uint32_t index = 0; index < MaxNumberOfEntities; index++) AddEntity(Entity);
 	}
 
 	// Returns nullptr in case no inactive entity is available.
@@ -59,19 +62,67 @@ public:
 		if (NumberOfInactiveEntities == 0) return nullptr;
 		NumberOfInactiveEntities--;
 
-		EntityType* const entity = &Entities[InactiveEntityIndexes[ReadIndex]];
+		uint32_t const index = InactiveEntityIndexes[ReadIndex];
+		EntityType* const entity = &Entities[index];
 		ReadIndex = (ReadIndex + 1) % MaxNumberOfEntities;
 		// Can't use static_cast because CEntity is abstract.
 		reinterpret_cast<CEntity*>(entity)->SetActive(true);
 
+		// Appending it to the dense list of active entities.
+		assert(PositionsInActiveList[index] == InvalidPosition);
+		PositionsInActiveList[index] = uint32_t(ActiveEntityIndexes.size());
+		ActiveEntityIndexes.push_back(index);
+
 		return entity;
 	}
 
+	uint32_t GetNumberOfActiveEntities() const { return uint32_t(ActiveEntityIndexes.size()); }
+	// Culling counters of the last SubmitAllActiveEntitiesInstanced.
+	SCullingStats const& GetCullingStats() const { return CullingStats; }
+
+	// Handles of active entities only.
+	SEntityHandle GetHandle(EntityType const* const Entity) const
+	{
+		SEntityHandle handle;
+		uint32_t const index = uint32_t(Entity - Entities);
+		if (index >= NumberOfEntities || PositionsInActiveList[index] == InvalidPosition) return handle;
+		handle.Index = index;
+		handle.Generation = Generations[index];
+		return handle;
+	}
+	// Returns nullptr if the entity has been deactivated since the handle was made.
+	EntityType* Get(SEntityHandle const& Handle) const
+	{
+		if (Handle.Index >= NumberOfEntities || Generations[Handle.Index] != Handle.Generation) return nullptr;
+		if (PositionsInActiveList[Handle.Index] == InvalidPosition) return nullptr;
+		return &Entities[Handle.Index];
+	}
+	// Direct access by slot index (no validity check).
+	EntityType* GetEntityAt(uint32_t const Index) const { assert(Index < NumberOfEntities); return &Entities[Index]; }
+
+	// Calls Function(Index, Entity) for every active entity.
+	template<typename FunctionType>
+	void ForEachActiveEntity(FunctionType const& Function)
+	{
+		for (uint32_t const index : ActiveEntityIndexes) Function(index, Entities[index]);
+	}
+	template<typename FunctionType>
+	void ForEachActiveEntity(FunctionType const& Function) const
+	{
+		for (uint32_t const index : ActiveEntityIndexes) Function(index, static_cast<EntityType const&>(Entities[index]));
+	}
+	// Slot indexes of the entities deactivated by the last UpdateAllActiveEntities(Parallel).
+	vector<uint32_t> const& GetEntitiesReleasedByLastUpdate() const { return ReleasedEntityIndexes; }
+
 	// Call this in CWorld::Update.
+	// Only the active entities are visited: the cost is proportional to the number of live entities, not to Size.
 	void UpdateAllActiveEntities(float const Dt)
 	{
-		for (uint16_t index = 0; index < NumberOfEntities; index++)
+		ReleasedEntityIndexes.clear();
+		uint32_t position = 0;
+		while (position < ActiveEntityIndexes.size())
 		{
+			uint32_t const index = ActiveEntityIndexes[position];
 			CEntity* const entity = reinterpret_cast<CEntity*>(&Entities[index]);
 
 			// We can access entity->Active here, which is extremely dodgy since this attribute of
@@ -79,37 +130,184 @@ public:
 			if (entity->IsActive()) entity->Update(Dt);
 			if (!entity->IsActive())
 			{
-				if (NumberOfInactiveEntities == NumberOfEntities) continue;
-
-				NumberOfInactiveEntities++;
-				InactiveEntityIndexes[WriteIndex] = index;
-				WriteIndex = (WriteIndex + 1) % MaxNumberOfEntities;
+				// The last active entity takes its place: do not advance.
+				ReleaseEntity(position);
+				continue;
 			}
+			position++;
 		}
 	}
 
-	void DrawAllActiveEntities(glm::vec3 const& CameraPosition, glm::mat4 const& ViewMatrix, glm::mat4 const& ProjectionMatrix, glm::vec3 const& LightPosition, glm::vec3 const& LightColor)
+	// Same as UpdateAllActiveEntities, with the active entities split into chunks updated by the threads of JobSystem.
+	// The deactivations are collected per thread and merged into the inactive ring afterwards, on the calling thread.
+	void UpdateAllActiveEntitiesParallel(float const Dt, CJobSystem& JobSystem)
 	{
-		for (uint16_t index = 0; index < NumberOfEntities; index++)
+		ReleasedEntityIndexes.clear();
+		DeactivatedEntities.resize(JobSystem.GetNumberOfThreads());
+		for (SThreadDeactivations& deactivations : DeactivatedEntities) deactivations.Indexes.clear();
+
+		JobSystem.ParallelFor(uint32_t(ActiveEntityIndexes.size()), ParallelChunkSize,
+			[this, Dt](uint32_t const Begin, uint32_t const End, uint32_t const ThreadIndex)
+			{
+				vector<uint32_t>& deactivated = DeactivatedEntities[ThreadIndex].Indexes;
+				for (uint32_t position = Begin; position < End; position++)
+				{
+					uint32_t const index = ActiveEntityIndexes[position];
+					CEntity* const entity = reinterpret_cast<CEntity*>(&Entities[index]);
+					if (entity->IsActive()) entity->Update(Dt);
+					if (!entity->IsActive()) deactivated.push_back(index);
+				}
+			});
+
+		// Sorted so that the order of the inactive ring doesn't depend on how the chunks were stolen (deterministic replays).
+		MergedDeactivations.clear();
+		for (SThreadDeactivations const& deactivations : DeactivatedEntities)
+		{
+			MergedDeactivations.insert(MergedDeactivations.end(), deactivations.Indexes.begin(), deactivations.Indexes.end());
+		}
+		std::sort(MergedDeactivations.begin(), MergedDeactivations.end());
+		for (uint32_t const index : MergedDeactivations) ReleaseEntity(PositionsInActiveList[index]);
+	}
+
+	void SubmitAllActiveEntities(CRenderQueue& Queue, glm::vec3 const& CameraPosition, glm::mat4 const& ProjectionMatrix)
+	{
+		for (uint32_t const index : ActiveEntityIndexes)
 		{
 			CEntity* const entity = reinterpret_cast<CEntity*>(&Entities[index]);
-			if (entity->IsActive()) entity->Draw(CameraPosition, ViewMatrix, ProjectionMatrix, LightPosition, LightColor);
+			if (entity->IsActive()) entity->Submit(Queue, CameraPosition, ProjectionMatrix);
+		}
+	}
+
+	// Instanced alternative to SubmitAllActiveEntities: the active entities are batched per model (and lod)
+	// and each batch is drawn with one glDrawElementsInstanced per mesh instead of one draw call per entity.
+	// If a Frustum is given, the entities whose bounding sphere is outside of it are not submitted.
+	void SubmitAllActiveEntitiesInstanced(CRenderQueue& Queue, glm::vec3 const& CameraPosition, glm::mat4 const& ProjectionMatrix, SFrustum const* const Frustum = nullptr)
+	{
+		for (SInstanceBatch& batch : InstanceBatches) batch.Instances.clear();
+
+		// Frustum culling: the bounding spheres are gathered as structure of arrays for the SIMD kernel.
+		uint32_t const numberOfActive = uint32_t(ActiveEntityIndexes.size());
+		CullingStats = SCullingStats();
+		if (Frustum)
+		{
+			CullX.resize(numberOfActive); CullY.resize(numberOfActive); CullZ.resize(numberOfActive);
+			CullRadius.resize(numberOfActive); CullVisible.resize(numberOfActive);
+			for (uint32_t position = 0; position < numberOfActive; position++)
+			{
+				CEntity const* const entity = reinterpret_cast<CEntity*>(&Entities[ActiveEntityIndexes[position]]);
+				glm::vec3 const center = entity->GetPosition();
+				CullX[position] = center.x; CullY[position] = center.y; CullZ[position] = center.z;
+				CullRadius[position] = entity->GetBoundingRadius();
+			}
+			CullSpheres(*Frustum, CullX.data(), CullY.data(), CullZ.data(), CullRadius.data(), numberOfActive, CullVisible.data());
+			CullingStats.Tested = numberOfActive;
+		}
+
+		for (uint32_t position = 0; position < numberOfActive; position++)
+		{
+			CEntity const* const entity = reinterpret_cast<CEntity*>(&Entities[ActiveEntityIndexes[position]]);
+			if (!entity->IsActive() || !entity->GetModel()) continue;
+			if (Frustum && !CullVisible[position]) { CullingStats.Culled++; continue; }
+			CullingStats.Drawn++;
+
+			SInstanceData instance;
+			instance.ModelMatrix = entity->GetDrawModelMatrix();
+			uint32_t const lod = entity->SelectLod(CameraPosition, ProjectionMatrix);
+			GetInstanceBatch(entity->GetModel(), !entity->IsDrawnWithTextures(), lod).Instances.push_back(instance);
+		}
+
+		for (SInstanceBatch& batch : InstanceBatches)
+		{
+			batch.Model->SubmitInstanced(Queue, batch.Instances, batch.ForceAmbient, batch.Lod);
 		}
 	}
 
 private:
-	uint16_t const MaxNumberOfEntities = Size;
+	// All the active entities sharing a model (and a shading mode and a lod) are drawn at once.
+	struct SInstanceBatch
+	{
+		CModel* Model = nullptr;
+		bool ForceAmbient = false;
+		uint32_t Lod = 0;
+		vector<SInstanceData> Instances;
+	};
+	// Kept from one frame to the next to avoid reallocating the instance arrays.
+	vector<SInstanceBatch> InstanceBatches;
+
+	SInstanceBatch& GetInstanceBatch(CModel* const Model, bool const ForceAmbient, uint32_t const Lod)
+	{
+		// Linear search: pools hold a handful of different models (times a handful of lods) at most.
+		for (SInstanceBatch& batch : InstanceBatches)
+		{
+			if (batch.Model == Model && batch.ForceAmbient == ForceAmbient && batch.Lod == Lod) return batch;
+		}
+		InstanceBatches.push_back(SInstanceBatch());
+		InstanceBatches.back().Model = Model;
+		InstanceBatches.back().ForceAmbient = ForceAmbient;
+		InstanceBatches.back().Lod = Lod;
+		InstanceBatches.back().Instances.reserve(MaxNumberOfEntities);
+		return InstanceBatches.back();
+	}
+
+	// Removes the entity at Position in the active list (swap-and-pop) and gives its index back to the inactive ring.
+	void ReleaseEntity(uint32_t const Position)
+	{
+		uint32_t const index = ActiveEntityIndexes[Position];
+		// The entity may only have been marked inactive (cf. CEntity::MarkInactive): deactivating its rigid body too.
+		reinterpret_cast<CEntity*>(&Entities[index])->SetActive(false);
+
+		uint32_t const lastIndex = ActiveEntityIndexes.back();
+		ActiveEntityIndexes[Position] = lastIndex;
+		PositionsInActiveList[lastIndex] = Position;
+		ActiveEntityIndexes.pop_back();
+		PositionsInActiveList[index] = InvalidPosition;
+		ReleasedEntityIndexes.push_back(index);
+
+		// Invalidates the handles to this entity.
+		Generations[index]++;
+
+		assert(NumberOfInactiveEntities < NumberOfEntities);
+		NumberOfInactiveEntities++;
+		InactiveEntityIndexes[WriteIndex] = index;
+		WriteIndex = (WriteIndex + 1) % MaxNumberOfEntities;
+	}
+
+	uint32_t const MaxNumberOfEntities = Size;
+	static constexpr uint32_t InvalidPosition = uint32_t(-1);
 
 	// The pool is empty upon creation with the default ctr.
-	uint16_t NumberOfEntities = 0;
-	uint16_t NumberOfInactiveEntities = 0;
+	uint32_t NumberOfEntities = 0;
+	uint32_t NumberOfInactiveEntities = 0;
 
 	// Contiguous heap storage for better performances (can allocate HUUGE chunks of memory tho).
+	// Entities never move: a slot index is a stable reference.
 	EntityType* Entities = nullptr;
 
-	uint16_t InactiveEntityIndexes[Size];
+	// Ring of the indexes of the inactive entities (heap-allocated, Size can be large).
+	vector<uint32_t> InactiveEntityIndexes;
 	// Where to read in InactiveEntityIndexes to get the index of an inactive entity.
-	uint16_t ReadIndex = 0;
+	uint32_t ReadIndex = 0;
 	// When deactivating an entity, where to write its index in InactiveEntityIndexes.
-	uint16_t WriteIndex = 0;
+	uint32_t WriteIndex = 0;
+
+	// Dense list of the indexes of the active entities (swap-and-pop on deactivation).
+	vector<uint32_t> ActiveEntityIndexes;
+	// Entity index -> position in ActiveEntityIndexes (InvalidPosition if inactive).
+	vector<uint32_t> PositionsInActiveList;
+	// Entity index -> number of times it has been deactivated (handle validation).
+	vector<uint32_t> Generations;
+	// Indexes released by the last update (lets the owner keep side structures in sync).
+	vector<uint32_t> ReleasedEntityIndexes;
+
+	// Number of entities per job of UpdateAllActiveEntitiesParallel.
+	static constexpr uint32_t ParallelChunkSize = 256;
+	// Per-thread deactivations of UpdateAllActiveEntitiesParallel (aligned to avoid false sharing).
+	struct alignas(64) SThreadDeactivations { vector<uint32_t> Indexes; };
+	vector<SThreadDeactivations> DeactivatedEntities;
+	vector<uint32_t> MergedDeactivations;
+
+	// Frustum culling scratch arrays (kept between frames) and counters.
+	vector<float> CullX, CullY, CullZ, CullRadius;
+	vector<uint8_t> CullVisible;
+	SCullingStats CullingStats;
 };
\ No newline at end of file
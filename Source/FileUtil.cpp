@@ -1,5 +1,8 @@
 #include "FileUtil.h"
 #include "StringUtil.h"
+#if defined(UNIX)
+	#include <sys/mman.h>
+#endif
 
 /**************************************************************************\
 *                                                                          *
@@ -298,6 +301,21 @@ bool createDirectory(const string& dir)
 	return isPathExist(pathname);
 }
 
+/**************************************************************************\
+*                                                                          *
+*  Create a directory and its missing parents.                             *
+*                                                                          *
+\**************************************************************************/
+bool createDirectories(const string& dir)
+{
+	string pathname = makeCorrectPath(dir, false);
+	for (size_t slash = pathname.find_first_of("/\\", 1); slash != string::npos; slash = pathname.find_first_of("/\\", slash + 1))
+	{
+		createDirectory(pathname.substr(0, slash));
+	}
+	return createDirectory(pathname);
+}
+
 /**************************************************************************\
 *                                                                          *
 *  Delete an ***EMPTY*** directory, doesn't fail if it doesn't exists.     *
@@ -661,3 +679,111 @@ bool isFilenameValid(const string& filename)
 
 	return true;
 }
+
+/**************************************************************************\
+*                                                                          *
+*  Last modification time of a file, in seconds since epoch (-1 on error). *
+*                                                                          *
+\**************************************************************************/
+s64 getFileModificationTime(const string& filename)
+{
+	struct __sstat64 status;
+
+	if (__stat64(filename.c_str(), &status) != -1 && (status.st_mode & S_IFREG))
+	{
+		return s64(status.st_mtime);
+	}
+
+	return -1;
+}
+
+/**************************************************************************\
+*                                                                          *
+*  FNV-1a 64 hash of a file's content. Returns true if no error.           *
+*                                                                          *
+\**************************************************************************/
+bool getFileHash(const string& filename, u64& hash)
+{
+	vector<uint8_t> content;
+	if (!loadFile(filename, content)) return false;
+	hash = 14695981039346656037ull;
+	for (uint8_t const byte : content) { hash ^= byte; hash *= 1099511628211ull; }
+	return true;
+}
+
+/**************************************************************************\
+*                                                                          *
+*  Canonical form of a path, to tell if two paths name the same file.      *
+*                                                                          *
+\**************************************************************************/
+string getCanonicalPath(const string& path)
+{
+#if defined(UNIX)
+	char* const resolved = realpath(path.c_str(), nullptr);
+	if (!resolved) return path;
+	string canonical(resolved);
+	free(resolved);
+	return canonical;
+#else
+	char resolved[_MAX_PATH];
+	if (!_fullpath(resolved, path.c_str(), _MAX_PATH)) return path;
+	string canonical(resolved);
+	std::replace(canonical.begin(), canonical.end(), '/', '\\');
+	std::transform(canonical.begin(), canonical.end(), canonical.begin(), [](char c) { return char(tolower((unsigned char)c)); });
+	return canonical;
+#endif
+}
+
+/**************************************************************************\
+*                                                                          *
+*  Maps a whole file in memory (read-only). Returns true if no error.      *
+*                                                                          *
+\**************************************************************************/
+bool CMappedFile::open(const string& path)
+{
+	close();
+
+#if defined(UNIX)
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd == -1) return false;
+
+	struct stat status;
+	if (fstat(fd, &status) == -1 || status.st_size == 0) { ::close(fd); return false; }
+
+	void* data = mmap(NULL, size_t(status.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);	// The mapping stays valid.
+	if (data == MAP_FAILED) return false;
+
+	m_data = (const uint8_t*)data;
+	m_size = size_t(status.st_size);
+#elif defined(WIN32)
+	m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (m_file == INVALID_HANDLE_VALUE) return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(m_file, &size) || size.QuadPart == 0) { close(); return false; }
+
+	m_mapping = CreateFileMappingA(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (m_mapping == NULL) { close(); return false; }
+
+	m_data = (const uint8_t*)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+	if (m_data == nullptr) { close(); return false; }
+	m_size = size_t(size.QuadPart);
+#endif
+	return true;
+}
+
+void CMappedFile::close()
+{
+#if defined(UNIX)
+	if (m_data) munmap((void*)m_data, m_size);
+#elif defined(WIN32)
+	if (m_data) UnmapViewOfFile(m_data);
+	if (m_mapping != NULL) CloseHandle(m_mapping);
+	if (m_file != INVALID_HANDLE_VALUE) CloseHandle(m_file);
+	m_mapping = NULL;
+	m_file = INVALID_HANDLE_VALUE;
+#endif
+	m_data = nullptr;
+	m_size = 0;
+}
\ No newline at end of file
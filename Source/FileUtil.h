@@ -18,6 +18,7 @@ s64		getFileSize(const string& filename);
 string	getCurrentDirectory();
 bool	setCurrentDirectory(const string& dir);
 bool	createDirectory(const string& dir);
+bool	createDirectories(const string& dir);	// Parents included.
 bool	deleteDirectory(const string& dir);
 bool	renameDirectory(const string& oldName, const string& newName);
 
@@ -31,3 +32,30 @@ string	makeCorrectFilePath(const string& originalPath);
 bool	isFilenameValid    (const string& filename);
 
 bool getFileDateTime(const string& filename, int& y,int& M,int& d, int& h,int& m,int& s);
+s64  getFileModificationTime(const string& filename);	// In s since epoch, -1 on error.
+bool getFileHash(const string& filename, u64& hash);		// FNV-1a 64 of the content.
+string getCanonicalPath(const string& path);				// Absolute, '.' and '..' resolved (lowercase on Windows). Unchanged on error.
+
+// Read-only memory mapping of a whole file.
+class CMappedFile
+{
+	public:
+		 CMappedFile() = default;
+		~CMappedFile() { close(); }
+		CMappedFile(const CMappedFile&) = delete;
+		CMappedFile& operator=(const CMappedFile&) = delete;
+
+		bool open(const string& path);
+		void close();
+
+		const uint8_t*	data() const { return m_data; }
+		size_t			size() const { return m_size; }
+
+	private:
+		const uint8_t*	m_data = nullptr;
+		size_t			m_size = 0;
+#if defined(WIN32)
+		HANDLE			m_file = INVALID_HANDLE_VALUE;
+		HANDLE			m_mapping = NULL;
+#endif
+};
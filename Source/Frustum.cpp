@@ -0,0 +1,88 @@
+#include "Frustum.h"
+#if defined(_M_X64) || defined(__SSE__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+	#define FRUSTUM_USE_SSE
+	#include <xmmintrin.h>
+#endif
+
+void SFrustum::ExtractFrom(glm::mat4 const& ViewProjectionMatrix)
+{
+	// glm matrices are column-major: row i is (m[0][i], m[1][i], m[2][i], m[3][i]).
+	glm::mat4 const& m = ViewProjectionMatrix;
+	glm::vec4 const row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+	glm::vec4 const row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+	glm::vec4 const row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+	glm::vec4 const row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+	Planes[Left]   = row3 + row0;
+	Planes[Right]  = row3 - row0;
+	Planes[Bottom] = row3 + row1;
+	Planes[Top]    = row3 - row1;
+	Planes[Near]   = row3 + row2;
+	Planes[Far]    = row3 - row2;
+
+	// Normalizing so that the plane equations give actual distances (compared to sphere radii).
+	for (glm::vec4& plane : Planes) plane /= glm::length(glm::vec3(plane));
+}
+
+bool SFrustum::IsSphereVisible(glm::vec3 const& Center, float const Radius) const
+{
+	for (glm::vec4 const& plane : Planes)
+	{
+		if (glm::dot(glm::vec3(plane), Center) + plane.w < -Radius) return false;
+	}
+	return true;
+}
+
+uint32_t CullSpheres(SFrustum const& Frustum, float const* X, float const* Y, float const* Z, float const* Radius, uint32_t const Count, uint8_t* VisibleOut)
+{
+	uint32_t numberOfVisible = 0;
+	uint32_t index = 0;
+
+#if defined(FRUSTUM_USE_SSE)
+	__m128 planeA[SFrustum::EnumCount], planeB[SFrustum::EnumCount], planeC[SFrustum::EnumCount], planeD[SFrustum::EnumCount];
+	for (int iPlane = 0; iPlane < SFrustum::EnumCount; iPlane++)
+	{
+		planeA[iPlane] = _mm_set1_ps(Frustum.Planes[iPlane].x);
+		planeB[iPlane] = _mm_set1_ps(Frustum.Planes[iPlane].y);
+		planeC[iPlane] = _mm_set1_ps(Frustum.Planes[iPlane].z);
+		planeD[iPlane] = _mm_set1_ps(Frustum.Planes[iPlane].w);
+	}
+	__m128 const zero = _mm_setzero_ps();
+	__m128 const allOnes = _mm_cmpeq_ps(zero, zero);
+
+	// 4 spheres per iteration.
+	for (; index + 4 <= Count; index += 4)
+	{
+		__m128 const x = _mm_loadu_ps(X + index);
+		__m128 const y = _mm_loadu_ps(Y + index);
+		__m128 const z = _mm_loadu_ps(Z + index);
+		__m128 const minusRadius = _mm_sub_ps(zero, _mm_loadu_ps(Radius + index));
+
+		__m128 visible = allOnes;
+		for (int iPlane = 0; iPlane < SFrustum::EnumCount; iPlane++)
+		{
+			__m128 distance = _mm_add_ps(_mm_mul_ps(planeA[iPlane], x), planeD[iPlane]);
+			distance = _mm_add_ps(distance, _mm_mul_ps(planeB[iPlane], y));
+			distance = _mm_add_ps(distance, _mm_mul_ps(planeC[iPlane], z));
+			visible = _mm_and_ps(visible, _mm_cmpge_ps(distance, minusRadius));
+		}
+
+		int const mask = _mm_movemask_ps(visible);
+		for (int k = 0; k < 4; k++)
+		{
+			uint8_t const isVisible = uint8_t((mask >> k) & 1);
+			VisibleOut[index + k] = isVisible;
+			numberOfVisible += isVisible;
+		}
+	}
+#endif
+
+	// Remainder (or everything without SSE).
+	for (; index < Count; index++)
+	{
+		uint8_t const isVisible = uint8_t(Frustum.IsSphereVisible(glm::vec3(X[index], Y[index], Z[index]), Radius[index]));
+		VisibleOut[index] = isVisible;
+		numberOfVisible += isVisible;
+	}
+	return numberOfVisible;
+}
\ No newline at end of file
@@ -0,0 +1,28 @@
+#pragma once
+#include "Types.h"
+
+// View frustum as 6 normalized planes (a, b, c, d): a point P is inside when a*P.x + b*P.y + c*P.z + d >= 0 for every plane.
+struct SFrustum
+{
+	enum EPlane : uint8_t { Left = 0, Right, Bottom, Top, Near, Far, EnumCount };
+	glm::vec4 Planes[EnumCount];
+
+	// Gribb-Hartmann extraction from ProjectionMatrix * ViewMatrix (world space planes).
+	void ExtractFrom(glm::mat4 const& ViewProjectionMatrix);
+
+	bool IsSphereVisible(glm::vec3 const& Center, float const Radius) const;
+};
+
+// Per-frame culling counters.
+struct SCullingStats
+{
+	uint32_t Tested = 0;
+	uint32_t Culled = 0;
+	uint32_t Drawn = 0;
+
+	SCullingStats& operator+=(SCullingStats const& Other) { Tested += Other.Tested; Culled += Other.Culled; Drawn += Other.Drawn; return *this; }
+};
+
+// Tests Count spheres given as structure of arrays, 4 per iteration with SSE (scalar fallback otherwise).
+// VisibleOut[k] is set to 1 if the sphere k intersects the frustum, 0 otherwise. Returns the number of visible spheres.
+uint32_t CullSpheres(SFrustum const& Frustum, float const* X, float const* Y, float const* Z, float const* Radius, uint32_t const Count, uint8_t* VisibleOut);
\ No newline at end of file
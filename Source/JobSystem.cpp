@@ -0,0 +1,98 @@
+#include "JobSystem.h"
+
+CJobSystem::CJobSystem(uint32_t NumberOfThreads)
+{
+	if (NumberOfThreads == 0) NumberOfThreads = std::max(1u, std::thread::hardware_concurrency());
+
+	for (uint32_t k = 0; k < NumberOfThreads; k++) Queues.push_back(std::make_unique<SQueue>());
+	for (uint32_t k = 1; k < NumberOfThreads; k++) Workers.emplace_back(&CJobSystem::WorkerLoop, this, k);
+}
+
+CJobSystem::~CJobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(WakeMutex);
+		Quit = true;
+	}
+	WakeCondition.notify_all();
+	for (std::thread& worker : Workers) worker.join();
+}
+
+void CJobSystem::ParallelFor(uint32_t const Count, uint32_t const ChunkSize, FJob const& Job)
+{
+	if (Count == 0) return;
+	assert(ChunkSize > 0);
+
+	// Single thread or single chunk: no need to wake anyone up.
+	uint32_t const numberOfChunks = (Count + ChunkSize - 1) / ChunkSize;
+	if (Workers.empty() || numberOfChunks == 1) { Job(0, Count, 0); return; }
+
+	// Set before the chunks are pushed: a worker still busy with the previous ParallelFor may pick them up right away.
+	CurrentJob = &Job;
+	PendingChunks.store(numberOfChunks);
+
+	// Spreading the chunks over the queues (contiguous ranges per thread for better locality).
+	uint32_t const numberOfThreads = GetNumberOfThreads();
+	for (uint32_t iChunk = 0; iChunk < numberOfChunks; iChunk++)
+	{
+		SChunk chunk;
+		chunk.Begin = iChunk * ChunkSize;
+		chunk.End = std::min(Count, chunk.Begin + ChunkSize);
+		SQueue& queue = *Queues[uint64_t(iChunk) * numberOfThreads / numberOfChunks];
+		std::lock_guard<std::mutex> lock(queue.Mutex);
+		queue.Chunks.push_back(chunk);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(WakeMutex);
+		Generation++;
+	}
+	WakeCondition.notify_all();
+
+	// The calling thread works too, then waits for the chunks still running on the workers.
+	while (PendingChunks.load() > 0)
+	{
+		if (!RunOneChunk(0)) std::this_thread::yield();
+	}
+	CurrentJob = nullptr;
+}
+
+void CJobSystem::WorkerLoop(uint32_t const ThreadIndex)
+{
+	uint64_t seenGeneration = 0;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(WakeMutex);
+			WakeCondition.wait(lock, [&]() { return Quit || Generation != seenGeneration; });
+			if (Quit) return;
+			seenGeneration = Generation;
+		}
+		while (RunOneChunk(ThreadIndex)) {}
+	}
+}
+
+bool CJobSystem::RunOneChunk(uint32_t const ThreadIndex)
+{
+	SChunk chunk;
+	bool found = false;
+
+	// Own queue first (back), ...
+	{
+		SQueue& queue = *Queues[ThreadIndex];
+		std::lock_guard<std::mutex> lock(queue.Mutex);
+		if (!queue.Chunks.empty()) { chunk = queue.Chunks.back(); queue.Chunks.pop_back(); found = true; }
+	}
+	// ... then stealing from the others (front).
+	for (uint32_t k = 1; !found && k < GetNumberOfThreads(); k++)
+	{
+		SQueue& queue = *Queues[(ThreadIndex + k) % GetNumberOfThreads()];
+		std::lock_guard<std::mutex> lock(queue.Mutex);
+		if (!queue.Chunks.empty()) { chunk = queue.Chunks.front(); queue.Chunks.pop_front(); found = true; }
+	}
+	if (!found) return false;
+
+	(*CurrentJob)(chunk.Begin, chunk.End, ThreadIndex);
+	PendingChunks.fetch_sub(1);
+	return true;
+}
\ No newline at end of file
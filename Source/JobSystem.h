@@ -0,0 +1,49 @@
+#pragma once
+#include "Types.h"
+
+// Minimal work-stealing thread pool.
+// ParallelFor splits a range into chunks spread over one queue per thread. Each thread pops chunks from
+// the back of its own queue and, once it is empty, steals from the front of the other threads' queues.
+// The calling thread takes part in the work (thread index 0) and blocks until every chunk is done.
+class CJobSystem
+{
+public:
+	// Job(Begin, End, ThreadIndex) processes [Begin, End). ThreadIndex is in [0, GetNumberOfThreads()).
+	using FJob = std::function<void(uint32_t const Begin, uint32_t const End, uint32_t const ThreadIndex)>;
+
+	// NumberOfThreads includes the calling thread. 0 = one thread per hardware thread.
+	explicit CJobSystem(uint32_t NumberOfThreads = 0);
+	~CJobSystem();
+
+	CJobSystem(CJobSystem const&) = delete;
+	CJobSystem& operator=(CJobSystem const&) = delete;
+
+	uint32_t GetNumberOfThreads() const { return uint32_t(Queues.size()); }
+
+	void ParallelFor(uint32_t const Count, uint32_t const ChunkSize, FJob const& Job);
+
+private:
+	struct SChunk { uint32_t Begin = 0, End = 0; };
+	struct SQueue
+	{
+		std::mutex Mutex;
+		std::deque<SChunk> Chunks;
+	};
+	// One queue per thread, index 0 is the calling thread's.
+	vector<std::unique_ptr<SQueue>> Queues;
+	vector<std::thread> Workers;
+
+	// The job of the current ParallelFor (only valid while PendingChunks > 0).
+	FJob const* CurrentJob = nullptr;
+	std::atomic<uint32_t> PendingChunks{ 0 };
+
+	// Wakes the workers up when a ParallelFor starts.
+	std::mutex WakeMutex;
+	std::condition_variable WakeCondition;
+	uint64_t Generation = 0;
+	bool Quit = false;
+
+	void WorkerLoop(uint32_t const ThreadIndex);
+	// Runs one chunk, from the thread's own queue or stolen. Returns false if there was nothing to run.
+	bool RunOneChunk(uint32_t const ThreadIndex);
+};
\ No newline at end of file
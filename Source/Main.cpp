@@ -4,6 +4,7 @@
 #include "Model.h"
 #include "Font.h"
 #include "World.h"
+#include "Benchmark.h"
 #include <reactphysics3d/reactphysics3d.h>
 
 // Default window dimensions in pixels.
@@ -64,12 +65,108 @@ GLFWwindow* Initialize()
 	return pWindow;
 }
 
-int main()
+// Runs the world simulation without any window nor OpenGL context and reports its throughput.
+// FixedStep = true: every tick advances the game by the same Dt (reproducible workload).
+// FixedStep = false: uncapped, every tick advances the game by the measured wall-clock time.
+// Records the run to RecordPath if not empty.
+int RunHeadless(uint32_t const NumberOfTicks, bool const FixedStep, string const& RecordPath)
 {
+	float const fixedDt = 1.f / 60.f;
+	ConsoleWriteOk("Headless simulation: %u ticks, %s.", NumberOfTicks, FixedStep ? "fixed step" : "uncapped");
+
+	CWorld World(nullptr);
+	if (!RecordPath.empty()) World.StartRecording(RecordPath);
+
+	using clock = std::chrono::steady_clock;
+	clock::time_point const startTime = clock::now();
+	clock::time_point previousTime = startTime;
+	for (uint32_t tick = 0; tick < NumberOfTicks; tick++)
+	{
+		clock::time_point const currentTime = clock::now();
+		float const Dt = FixedStep ? fixedDt : std::chrono::duration<float>(currentTime - previousTime).count();
+		previousTime = currentTime;
+
+		CProfiler::Get().BeginFrame();
+		World.Update(Dt);
+		CProfiler::Get().EndFrame();
+	}
+	double const elapsed = std::chrono::duration<double>(clock::now() - startTime).count();
+
+	ConsoleWrite(" -> %.3f s, %.1f ticks/s (%.3f ms/tick)", elapsed, NumberOfTicks / elapsed, 1000. * elapsed / NumberOfTicks);
+	return 0;
+}
+
+// Usage: StarFauxGL [--headless [--ticks N] [--uncapped]] [--bench <name>] [--trace <file.json>]
+//                   [--seed N] [--record <file>] [--replay <file>] [--float-vertices]
+// --trace: profiles the last frames and writes them as a Chrome trace on exit.
+// --stats: prints the frame statistics (shaders, culling, render queue, physics) every second.
+// --record: records the session (windowed or headless) for --replay, which re-simulates it headless and checks the state hashes.
+// --float-vertices: unpacked vertex buffers (cf. EVertexLayout), to compare.
+// --upload-budget <ms>: time per frame given to the GL uploads of the models streamed in the background (2 by default).
+// --no-program-cache: always compiles the shaders from GLSL (no glProgramBinary cache), to compare.
+// --lod-error <pixels>: screen-space error allowed when selecting the level of detail of the models (1 by default, 0 = always lod 0).
+// --asteroid-collisions: asteroids collide with each other too (rejected by the broad phase by default, cf. SPhysicsSettings).
+// --no-sleeping: the bodies at rest are still simulated.
+// --inline-physics: the physics steps run in the game thread's update instead of a dedicated thread (always the case headless and recording).
+// --max-substeps <N>: physics steps per frame at most (4 by default, 0 = no limit), the simulation time beyond is dropped.
+// --step-budget <ms>: wall-clock time per frame the inline physics steps may take (8 by default, 0 = no budget).
+// --time-dilation: the game slows down instead of only the physics when steps are dropped.
+int main(int argc, char** argv)
+{
+	bool headless = false, fixedStep = true, printStats = false;
+	uint32_t numberOfTicks = 10000;
+	string tracePath, recordPath, replayPath;
+	float uploadBudget = 2.f;
+	SPhysicsSettings physicsSettings;
+	for (int iArg = 1; iArg < argc; iArg++)
+	{
+		string const arg = argv[iArg];
+		if (arg == "--headless") headless = true;
+		else if (arg == "--uncapped") fixedStep = false;
+		else if (arg == "--ticks" && iArg + 1 < argc) numberOfTicks = uint32_t(std::max(1, atoi(argv[++iArg])));
+		else if (arg == "--bench" && iArg + 1 < argc) return RunBenchmark(argv[++iArg]);
+		else if (arg == "--trace" && iArg + 1 < argc) tracePath = argv[++iArg];
+		else if (arg == "--stats") printStats = true;
+		else if (arg == "--seed" && iArg + 1 < argc) CRandomizer::SetGlobalSeed(strtoull(argv[++iArg], nullptr, 10));
+		else if (arg == "--record" && iArg + 1 < argc) recordPath = argv[++iArg];
+		else if (arg == "--replay" && iArg + 1 < argc) replayPath = argv[++iArg];
+		else if (arg == "--float-vertices") CModel::SetVertexLayout(EVertexLayout::Float);
+		else if (arg == "--upload-budget" && iArg + 1 < argc) uploadBudget = float(std::max(0., atof(argv[++iArg])));
+		else if (arg == "--no-program-cache") CShader::SetBinaryCacheEnabled(false);
+		else if (arg == "--lod-error" && iArg + 1 < argc) CModel::SetLodMaxPixelError(float(atof(argv[++iArg])));
+		else if (arg == "--asteroid-collisions") physicsSettings.AsteroidSelfCollisions = true;
+		else if (arg == "--no-sleeping") physicsSettings.SleepingEnabled = false;
+		else if (arg == "--inline-physics") physicsSettings.Threading = EPhysicsThreading::Inline;
+		else if (arg == "--max-substeps" && iArg + 1 < argc) physicsSettings.Substeps.MaxSubstepsPerFrame = uint32_t(std::max(0, atoi(argv[++iArg])));
+		else if (arg == "--step-budget" && iArg + 1 < argc) physicsSettings.Substeps.StepBudget = float(std::max(0., atof(argv[++iArg])));
+		else if (arg == "--time-dilation") physicsSettings.Substeps.TimeDilation = true;
+	}
+	// A replay re-simulates the frames with the transforms the game read: they have to be the ones of the frame.
+	if (!recordPath.empty()) physicsSettings.Threading = EPhysicsThreading::Inline;
+	// Nor can the steps depend on how long they took (a replay gets its settings from the file).
+	if (!recordPath.empty()) physicsSettings.Substeps.StepBudget = 0.f;
+	CWorld::SetPhysicsSettings(physicsSettings);
+	CProfiler::Get().SetEnabled(!tracePath.empty());
+	if (headless || !replayPath.empty())
+	{
+		if (!replayPath.empty() && !recordPath.empty()) { ConsoleWriteErr("--record can't be combined with --replay"); return -1; }
+		int const res = replayPath.empty() ? RunHeadless(numberOfTicks, fixedStep, recordPath) : RunReplay(replayPath);
+		if (!tracePath.empty()) CProfiler::Get().SaveChromeTrace(tracePath);
+		return res;
+	}
+
 	GLFWwindow* const window = Initialize();
 	if (!window) return -1;
+	// Timer queries are core since OpenGL 3.3.
+	CProfiler::Get().SetGpuTimingsEnabled(CProfiler::Get().IsEnabled());
 
+	// Cold start: the models stream in the background (mesh caches, textures, shaders), the pools are filled.
+	double const startupTime = glfwGetTime();
 	CWorld World(window);
+	World.SetAssetUploadBudget(uploadBudget);
+	ConsoleWriteOk("World ready in %.1f ms", 1e3 * (glfwGetTime() - startupTime));
+	bool firstFrame = true, assetsReady = false;
+	if (!recordPath.empty()) World.StartRecording(recordPath);
 	glfwSetWindowUserPointer(window, &World);
 	glfwSetKeyCallback
 	(
@@ -82,6 +179,9 @@ int main()
 
 	// In s.
 	float previousTime = float(glfwGetTime());
+	// Frame statistics are printed every StatsPeriod seconds (--stats).
+	float const StatsPeriod = 1.f;
+	float statsTime = 0.f;
 	// Game loop.
 	while (!glfwWindowShouldClose(window))
 	{
@@ -89,6 +189,7 @@ int main()
 		float const currentTime  = float(glfwGetTime());
 		float const Dt = currentTime - previousTime;
 		previousTime = currentTime;
+		CProfiler::Get().BeginFrame();
 		
 		// Update the game world.
 		World.Update(Dt);
@@ -98,10 +199,47 @@ int main()
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 		World.Render();
 
-		glfwSwapBuffers(window);
+		{
+			PROFILE_CPU_SCOPE("glfwSwapBuffers");
+			glfwSwapBuffers(window);
+		}
+		if (firstFrame) { ConsoleWriteOk("First frame in %.1f ms", 1e3 * (glfwGetTime() - startupTime)); firstFrame = false; }
+		if (!assetsReady && World.AreAssetsReady())
+		{
+			ConsoleWriteOk("All assets ready in %.1f ms", 1e3 * (glfwGetTime() - startupTime));
+			// The shared programs spare a build per model, the program binaries spare the GLSL compilation of the builds.
+			CShaderLibrary const& shaderLibrary = CShaderLibrary::Get();
+			uint32_t const numberOfBuilds = std::max(1u, shaderLibrary.GetNumberOfBuilds());
+			ConsoleWrite("Shaders: %u programs built in %.1f ms (%u from program binaries, %u compiled), %u shared acquisitions (~%.1f ms saved)",
+				shaderLibrary.GetNumberOfBuilds(), shaderLibrary.GetBuildTime(), CShader::GetNumberOfBinaryPrograms(), CShader::GetNumberOfCompiledPrograms(),
+				shaderLibrary.GetNumberOfHits(), shaderLibrary.GetNumberOfHits() * shaderLibrary.GetBuildTime() / numberOfBuilds);
+			assetsReady = true;
+		}
 		glfwPollEvents();
+		CProfiler::Get().EndFrame();
+
+		CShader::NewFrame();
+		statsTime += Dt;
+		if (printStats && statsTime >= StatsPeriod)
+		{
+			SCullingStats const& cullingStats = World.GetCullingStats();
+			ConsoleWrite("Uniform lookups avoided per frame: %u", CShader::GetLookupsAvoidedLastFrame());
+			ConsoleWrite("Asteroids per frame: %u tested, %u culled, %u drawn", cullingStats.Tested, cullingStats.Culled, cullingStats.Drawn);
+			SRenderStats const& renderStats = World.GetRenderStats();
+			ConsoleWrite("Render queue per frame: %u draws, %u state changes (%u programs, %u textures, %u VAOs, %u instance buffers) instead of %u",
+				renderStats.Draws, renderStats.GetStateChanges(), renderStats.ProgramBinds, renderStats.TextureBinds, renderStats.VAOBinds,
+				renderStats.InstanceBufferBinds, renderStats.ImmediateBinds);
+			ConsoleWrite("Uniform buffers per frame: %u bytes uploaded", renderStats.UniformBytes);
+			SPhysicsStats const& physicsStats = World.GetPhysicsStats();
+			ConsoleWrite("Physics per frame: %u substeps, %u contact pairs, %.2f ms, %u steps behind", physicsStats.Substeps, physicsStats.ContactPairs,
+				physicsStats.StepTime, physicsStats.StepsBehind);
+			ConsoleWrite("Physics time dropped: %.3f s since the start, time scale %.2f", physicsStats.TotalDroppedTime, physicsStats.TimeScale);
+			statsTime = 0.f;
+		}
 	}
 
+	if (!tracePath.empty()) CProfiler::Get().SaveChromeTrace(tracePath);
+	CProfiler::Get().SetGpuTimingsEnabled(false);
 	glfwTerminate();
 	return 0;
 }
\ No newline at end of file
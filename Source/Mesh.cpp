@@ -1,9 +1,12 @@
 #include "Mesh.h"
+#include "RenderQueue.h"
+#include <glm/gtc/packing.hpp>
 
 CMesh::CMesh
 (
-			const vector<SVertex>& vertices,
-			const vector<GLuint>& indices,
+			const SVertex* vertices, size_t numVertices,
+			const GLuint* indices, size_t numIndices,
+			const vector<SMeshLod>& lods,
 			const vector<CTexture>& textures,
 			const glm::mat4& matColors,
 			bool bHasNormals, bool bHasTexCoords, bool bHasColors,
@@ -11,34 +14,82 @@ CMesh::CMesh
 			const CShader& shaderColorPhong,
 			const CShader& shaderColorAmbient,
 			const CShader& shaderTextureDiffuse,
-			const CShader& shaderTextureAmbient
+			const CShader& shaderTextureAmbient,
+			const CShader& shaderColorPhongInstanced,
+			const CShader& shaderColorAmbientInstanced,
+			const CShader& shaderTextureDiffuseInstanced,
+			const CShader& shaderTextureAmbientInstanced,
+			bool bCpuOnly,
+			EVertexLayout vertexLayout
 )
-	: m_vertices(vertices)
-	, m_indices(indices)
-	, m_textures(textures)
+	: m_textures(textures)
 	, m_matColors(matColors)
+	, m_numVertices(numVertices)
+	, m_numIndices(numIndices)
+	, m_lods(lods)
 	, m_bHasNormals(bHasNormals)
 	, m_bHasTexCoords(bHasTexCoords)
 	, m_bHasColors(bHasColors)
 	, m_bHasAmbientTex (bHasAmbientTex)
 	, m_bHasDiffuseTex (bHasDiffuseTex)
 	, m_bHasSpecularTex(bHasSpecularTex)
+	, m_bCpuOnly(bCpuOnly)
+	, m_vertexLayout(vertexLayout)
 	, m_shaderColorPhong    (shaderColorPhong)
 	, m_shaderColorAmbient  (shaderColorAmbient)
 	, m_shaderTextureDiffuse(shaderTextureDiffuse)
 	, m_shaderTextureAmbient(shaderTextureAmbient)
+	, m_shaderColorPhongInstanced    (shaderColorPhongInstanced)
+	, m_shaderColorAmbientInstanced  (shaderColorAmbientInstanced)
+	, m_shaderTextureDiffuseInstanced(shaderTextureDiffuseInstanced)
+	, m_shaderTextureAmbientInstanced(shaderTextureAmbientInstanced)
 {
+	m_VAO[0] = m_VBO[0] = m_EBO[0] = 0;
+	if (m_lods.empty())
+	{
+		SMeshLod lod;
+		lod.IndexCount = uint32_t(numIndices);
+		m_lods.push_back(lod);
+	}
+	// Headless mode: we only keep the CPU-side geometry (copied: it may point into a mesh cache unmapped after the load), no GL call at all.
+	if (m_bCpuOnly)
+	{
+		m_cpuVertices.assign(vertices, vertices + numVertices);
+		m_cpuIndices.assign(indices, indices + numIndices);
+		return;
+	}
+
 	glGenVertexArrays(1, m_VAO);
 	glGenBuffers(1, m_VBO);
 	glGenBuffers(1, m_EBO);
 
 	glBindVertexArray(m_VAO[0]);
 
+	// 16-bit indices whenever they fit.
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EBO[0]);
+	if (numVertices < 65536)
+	{
+		vector<GLushort> shortIndices(indices, indices + numIndices);
+		m_indexType = GL_UNSIGNED_SHORT;
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, numIndices * sizeof(GLushort), shortIndices.data(), GL_STATIC_DRAW);
+	}
+	else
+	{
+		m_indexType = GL_UNSIGNED_INT;
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, numIndices * sizeof(GLuint), indices, GL_STATIC_DRAW);
+	}
+
 	glBindBuffer(GL_ARRAY_BUFFER, m_VBO[0]);
-	glBufferData(GL_ARRAY_BUFFER, m_vertices.size() * sizeof(SVertex), m_vertices.data(), GL_STATIC_DRAW);
+	if (m_vertexLayout == EVertexLayout::Packed) setupPackedVertices(vertices, numVertices);
+	else setupFloatVertices(vertices, numVertices);
 
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EBO[0]);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_indices.size() * sizeof(GLuint), m_indices.data(), GL_STATIC_DRAW);
+	glBindVertexArray(0);
+}
+
+void CMesh::setupFloatVertices(const SVertex* vertices, size_t numVertices)
+{
+	m_vertexBufferSize = numVertices * sizeof(SVertex);
+	glBufferData(GL_ARRAY_BUFFER, m_vertexBufferSize, vertices, GL_STATIC_DRAW);
 
 	// vertex positions
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(SVertex), (GLvoid*)offsetof(SVertex, Position));
@@ -76,16 +127,95 @@ CMesh::CMesh
 	{
 		glDisableVertexAttribArray(3);
 	}
-
-	glBindVertexArray(0);
 }
 
-void CMesh::Draw(glm::vec3 const& camPos, const glm::mat4& model, const glm::mat4& view, const glm::mat4& proj, const glm::vec3& lightPos, const glm::vec3& lightColor, bool bForceAmbient)
+void CMesh::setupPackedVertices(const SVertex* vertices, size_t numVertices)
 {
-	// Note : Il faut utiliser bForceAmbient  true pour les modeles 3D ayant des normales incohrentes
+	// Positions are stored relative to the mesh AABB, the vertex shaders decode them with positionScale/positionOffset.
+	glm::vec3 aabbMin(FLT_MAX), aabbMax(-FLT_MAX);
+	for (size_t i = 0; i < numVertices; i++)
+	{
+		aabbMin = glm::min(aabbMin, vertices[i].Position);
+		aabbMax = glm::max(aabbMax, vertices[i].Position);
+	}
+	if (numVertices == 0) aabbMin = aabbMax = glm::vec3(0.f);
+	m_positionOffset = aabbMin;
+	m_positionScale  = glm::max(aabbMax - aabbMin, glm::vec3(1e-6f)); // Flat meshes.
 
-	glm::mat3 normalMatrix = glm::mat3(glm::transpose(glm::inverse(model)));
+	// position (4 x u16, the 4th is padding) + normal (i32 2_10_10_10) + uv (2 x f16) [+ color (4 x u8)]
+	size_t const colorOffset = sizeof(uint64_t) + 2 * sizeof(uint32_t);
+	size_t const stride = colorOffset + (m_bHasColors ? sizeof(uint32_t) : 0);
+	vector<uint8_t> packed(numVertices * stride);
+	for (size_t i = 0; i < numVertices; i++)
+	{
+		const SVertex& vertex = vertices[i];
+		uint8_t* dst = &packed[i * stride];
+
+		uint64_t const position = glm::packUnorm4x16(glm::vec4((vertex.Position - m_positionOffset) / m_positionScale, 0.f));
+		float const normalLength = glm::length(vertex.Normal);
+		uint32_t const normal   = glm::packSnorm3x10_1x2(glm::vec4(normalLength > 0.f ? vertex.Normal / normalLength : glm::vec3(1.f, 0.f, 0.f), 0.f));
+		uint32_t const texCoord = glm::packHalf2x16(glm::vec2(vertex.TexCoords));
+		std::memcpy(dst, &position, sizeof(position));
+		std::memcpy(dst + sizeof(uint64_t), &normal, sizeof(normal));
+		std::memcpy(dst + sizeof(uint64_t) + sizeof(uint32_t), &texCoord, sizeof(texCoord));
+		if (m_bHasColors)
+		{
+			uint32_t const color = glm::packUnorm4x8(vertex.Colors);
+			std::memcpy(dst + colorOffset, &color, sizeof(color));
+		}
+	}
+
+	m_vertexBufferSize = packed.size();
+	glBufferData(GL_ARRAY_BUFFER, m_vertexBufferSize, packed.data(), GL_STATIC_DRAW);
+
+	// vertex positions
+	glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, (GLsizei)stride, (GLvoid*)0);
+	glEnableVertexAttribArray(0);
+
+	// vertex normals
+	if (m_bHasNormals)
+	{
+		glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, (GLsizei)stride, (GLvoid*)sizeof(uint64_t));
+		glEnableVertexAttribArray(1);
+	}
+	else
+	{
+		glDisableVertexAttribArray(1);
+	}
 
+	// vertex texture coordinates
+	if (m_bHasTexCoords)
+	{
+		glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, (GLsizei)stride, (GLvoid*)(sizeof(uint64_t) + sizeof(uint32_t)));
+		glEnableVertexAttribArray(2);
+	}
+	else
+	{
+		glDisableVertexAttribArray(2);
+	}
+
+	// vertex colors
+	if (m_bHasColors)
+	{
+		glVertexAttribPointer(3, 4, GL_UNSIGNED_BYTE, GL_TRUE, (GLsizei)stride, (GLvoid*)colorOffset);
+		glEnableVertexAttribArray(3);
+	}
+	else
+	{
+		glDisableVertexAttribArray(3);
+	}
+}
+
+void CMesh::getLodRange(uint32_t lod, GLsizei& count, const GLvoid*& offset) const
+{
+	const SMeshLod& range = m_lods[std::min(size_t(lod), m_lods.size() - 1)];
+	count = (GLsizei)range.IndexCount;
+	offset = (const GLvoid*)(size_t(range.IndexOffset) * (m_indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint)));
+}
+
+bool CMesh::setupDrawItem(SDrawItem& item, bool bForceAmbient, bool bInstanced, uint32_t lod) const
+{
+	// Note : Il faut utiliser bForceAmbient  true pour les modeles 3D ayant des normales incohrentes
 	if (m_textures.size() > 0)
 	{
 		// L'algo est basique, quand on texture, on ignore les combinaisons ambiant+diffus+spculaire, on prend que le 1er venu.
@@ -101,14 +231,8 @@ void CMesh::Draw(glm::vec3 const& camPos, const glm::mat4& model, const glm::mat
 					break;
 				}
 			}
-			m_shaderTextureAmbient.Use();
-			glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_2D, m_textures[index].m_id);
-			m_shaderTextureAmbient.SetUniform("texture_ambient", 0);
-			m_shaderTextureAmbient.SetUniform("model", model);
-			m_shaderTextureAmbient.SetUniform("view", view);
-			m_shaderTextureAmbient.SetUniform("proj", proj);
-			m_shaderTextureAmbient.SetUniform("lightColor", lightColor);
+			item.Shader = bInstanced ? &m_shaderTextureAmbientInstanced : &m_shaderTextureAmbient;
+			item.SamplerName = "texture_ambient";
 		}
 		else if (m_bHasDiffuseTex)
 		{
@@ -120,49 +244,87 @@ void CMesh::Draw(glm::vec3 const& camPos, const glm::mat4& model, const glm::mat
 					break;
 				}
 			}
-			m_shaderTextureDiffuse.Use();
-			glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_2D, m_textures[index].m_id);
-			m_shaderTextureDiffuse.SetUniform("texture_diffuse", 0);
-			m_shaderTextureDiffuse.SetUniform("model", model);
-			m_shaderTextureDiffuse.SetUniform("view", view);
-			m_shaderTextureDiffuse.SetUniform("proj", proj);
-			m_shaderTextureDiffuse.SetUniform("normalMatrix", normalMatrix);
-			m_shaderTextureDiffuse.SetUniform("lightColor", lightColor);
-			m_shaderTextureDiffuse.SetUniform("lightPosition", lightPos);
+			item.Shader = bInstanced ? &m_shaderTextureDiffuseInstanced : &m_shaderTextureDiffuse;
+			item.SamplerName = "texture_diffuse";
 		}
 		else
 		{
 			// m_bHasSpecularTex, unsupported 
+			return false;
 		}
+		item.Texture = m_textures[index].IsReady() ? m_textures[index].m_id : 0;
 	}
 	else
 	{
 		if (bForceAmbient)
 		{
-			m_shaderColorAmbient.Use();
-			m_shaderColorAmbient.SetUniform("material", m_matColors);
-			m_shaderColorAmbient.SetUniform("model", model);
-			m_shaderColorAmbient.SetUniform("view", view);
-			m_shaderColorAmbient.SetUniform("proj", proj);
-			m_shaderColorAmbient.SetUniform("lightColor", lightColor);
+			item.Shader = bInstanced ? &m_shaderColorAmbientInstanced : &m_shaderColorAmbient;
 		}
 		else
 		{
-			m_shaderColorPhong.Use();
-			m_shaderColorPhong.SetUniform("material", m_matColors);
-			m_shaderColorPhong.SetUniform("model", model);
-			m_shaderColorPhong.SetUniform("view", view);
-			m_shaderColorPhong.SetUniform("proj", proj);
-			m_shaderColorPhong.SetUniform("normalMatrix", normalMatrix);
-			m_shaderColorPhong.SetUniform("cameraPosition", camPos);
-			m_shaderColorPhong.SetUniform("lightColor", lightColor);
-			m_shaderColorPhong.SetUniform("lightPosition", lightPos);
+			item.Shader = bInstanced ? &m_shaderColorPhongInstanced : &m_shaderColorPhong;
 		}
+		item.Material = m_matColors;
 	}
 
-	// Draw
+	item.VAO = m_VAO[0];
+	item.IndexType = m_indexType;
+	getLodRange(lod, item.IndexCount, item.IndexOffset);
+	item.PositionScale = m_positionScale;
+	item.PositionOffset = m_positionOffset;
+	item.SortKey = CRenderQueue::MakeSortKey(0, item.Shader, item.Texture, item.VAO);
+	return true;
+}
+
+void CMesh::Submit(CRenderQueue& queue, const glm::mat4& model, const glm::mat3& normalMatrix, bool bForceAmbient, uint32_t lod) const
+{
+	if (m_bCpuOnly) return;
+
+	SDrawItem item;
+	if (!setupDrawItem(item, bForceAmbient, false, lod)) return;
+	item.Model = model;
+	item.NormalMatrix = normalMatrix;
+	queue.Submit(item);
+}
+
+void SetInstanceAttributes(GLuint instanceVBO, uint32_t firstInstance)
+{
+	glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+	size_t const base = size_t(firstInstance) * sizeof(SInstanceData);
+
+	// instance model matrix (a mat4 takes 4 consecutive attribute locations)
+	for (GLuint column = 0; column < 4; column++)
+	{
+		glVertexAttribPointer(4 + column, 4, GL_FLOAT, GL_FALSE, sizeof(SInstanceData), (GLvoid*)(base + offsetof(SInstanceData, ModelMatrix) + column * sizeof(glm::vec4)));
+		glEnableVertexAttribArray(4 + column);
+		glVertexAttribDivisor(4 + column, 1);
+	}
+
+	// instance color
+	glVertexAttribPointer(8, 4, GL_FLOAT, GL_FALSE, sizeof(SInstanceData), (GLvoid*)(base + offsetof(SInstanceData, Color)));
+	glEnableVertexAttribArray(8);
+	glVertexAttribDivisor(8, 1);
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void CMesh::SetInstanceBuffer(GLuint instanceVBO)
+{
+	if (m_bCpuOnly) return;
+
 	glBindVertexArray(m_VAO[0]);
-	glDrawElements(GL_TRIANGLES, (GLsizei)m_indices.size(), GL_UNSIGNED_INT, 0);
+	SetInstanceAttributes(instanceVBO, 0);
 	glBindVertexArray(0);
+}
+
+void CMesh::SubmitInstanced(CRenderQueue& queue, GLuint instanceVBO, uint32_t firstInstance, GLsizei instanceCount, bool bForceAmbient, uint32_t lod) const
+{
+	if (m_bCpuOnly || instanceCount <= 0) return;
+
+	SDrawItem item;
+	if (!setupDrawItem(item, bForceAmbient, true, lod)) return;
+	item.InstanceCount = instanceCount;
+	item.InstanceVBO = instanceVBO;
+	item.FirstInstance = firstInstance;
+	queue.Submit(item);
 }
\ No newline at end of file
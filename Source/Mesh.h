@@ -2,6 +2,7 @@
 #include "Types.h"
 #include "Shader.h"
 #include "Texture.h"
+#include <reactphysics3d/reactphysics3d.h>
 
 struct SVertex
 {
@@ -11,16 +12,54 @@ struct SVertex
 	glm::vec4 Colors;
 };
 
+struct SAABB 
+{
+	float XMin = 0.f, XMax = 0.f, YMin = 0.f, YMax = 0.f, ZMin = 0.f, ZMax = 0.f;
+	rp3d::Vector3 GetLength() const;
+	float GetMaxLength() const;
+	// Radius of the smallest sphere centered on the origin (of the model) containing the box.
+	float GetBoundingRadius() const;
+};
+
+// Level of detail of a CMesh: a range of its index buffer over the shared vertex buffer.
+struct SMeshLod
+{
+	uint32_t IndexOffset = 0;
+	uint32_t IndexCount = 0;
+	float Error = 0.f; // Geometric error (model units) compared to LOD 0.
+};
+
+// Per-instance attributes of the instanced draw path (locations 4 to 8, cf. *_inst.vert shaders).
+struct SInstanceData
+{
+	glm::mat4 ModelMatrix = glm::mat4(1.f);
+	glm::vec4 Color = glm::vec4(1.f);
+};
+
+// Points the instance attributes (locations 4 to 8) of the bound VAO to instanceVBO, from firstInstance on.
+void SetInstanceAttributes(GLuint instanceVBO, uint32_t firstInstance);
+
+class CRenderQueue;
+struct SDrawItem;
+
+// Layout of the vertex buffer of a CMesh.
+// Float:  SVertex as is, 52 bytes.
+// Packed: 16-bit normalized positions relative to the mesh AABB, GL_INT_2_10_10_10_REV normals, half-float UVs,
+//         and RGBA8 colors only when the mesh has some: 16 bytes (20 with colors).
+enum class EVertexLayout : uint8_t { Float, Packed };
+
 class CMesh
 {
 	public:
-		vector<SVertex>	m_vertices;
-		vector<GLuint>	m_indices;
 		vector<CTexture>	m_textures;
 		glm::mat4		m_matColors;
 
-		CMesh(const vector<SVertex>&  vertices,
-			 const vector<GLuint>&  indices,
+		// The geometry is uploaded straight from vertices/indices (which may point into a mapped mesh cache), no CPU-side
+		// copy is kept but in headless mode (bCpuOnly), where it is copied instead of uploaded.
+		// indices holds the index ranges of all the lods (a single lod if lods is empty).
+		CMesh(const SVertex* vertices, size_t numVertices,
+			 const GLuint* indices, size_t numIndices,
+			 const vector<SMeshLod>& lods,
 			 const vector<CTexture>& textures,
 			 const glm::mat4& matColors,
 			 bool bHasNormals,
@@ -32,11 +71,35 @@ class CMesh
 			 const CShader& shaderColorPhong,
 			 const CShader& shaderColorAmbient,
 			 const CShader& shaderTextureDiffuse,
-			 const CShader& shaderTextureAmbient);
+			 const CShader& shaderTextureAmbient,
+			 const CShader& shaderColorPhongInstanced,
+			 const CShader& shaderColorAmbientInstanced,
+			 const CShader& shaderTextureDiffuseInstanced,
+			 const CShader& shaderTextureAmbientInstanced,
+			 bool bCpuOnly = false,
+			 EVertexLayout vertexLayout = EVertexLayout::Packed);
 
-		void Draw(glm::vec3 const& camPos, const glm::mat4& model, const glm::mat4& view, const glm::mat4& proj, const glm::vec3& lightPos, const glm::vec3& lightColor, bool bForceAmbient);
+		// The draws go through the render queue, which binds the program, texture and VAO only when they change.
+		void Submit(CRenderQueue& queue, const glm::mat4& model, const glm::mat3& normalMatrix, bool bForceAmbient, uint32_t lod = 0) const;
+
+		// Instanced path: the model matrices (and colors) come from an instance buffer of SInstanceData
+		// owned by the CModel. SetInstanceBuffer has to be called once before the first SubmitInstanced.
+		void SetInstanceBuffer(GLuint instanceVBO);
+		void SubmitInstanced(CRenderQueue& queue, GLuint instanceVBO, uint32_t firstInstance, GLsizei instanceCount, bool bForceAmbient, uint32_t lod = 0) const;
+
+		size_t			GetNumberOfVertices() const { return m_numVertices; }
+		size_t			GetNumberOfIndices() const { return m_numIndices; }
+		size_t			GetVertexBufferSize() const { return m_vertexBufferSize; } // In bytes.
+		const vector<SMeshLod>& GetLods() const { return m_lods; }
+		// Headless mode only (empty otherwise: the geometry is on the GPU).
+		const vector<SVertex>&	GetCpuVertices() const { return m_cpuVertices; }
+		const vector<GLuint>&	GetCpuIndices() const { return m_cpuIndices; }
 
 	private:
+		size_t			m_numVertices;
+		size_t			m_numIndices;
+		GLenum			m_indexType = GL_UNSIGNED_INT; // GL_UNSIGNED_SHORT below 65536 vertices.
+		vector<SMeshLod>	m_lods;
 		GLuint			m_VAO[1];
 		GLuint			m_VBO[1];
 		GLuint			m_EBO[1];
@@ -46,9 +109,28 @@ class CMesh
 		bool			m_bHasAmbientTex;
 		bool			m_bHasDiffuseTex;
 		bool			m_bHasSpecularTex;
+		bool			m_bCpuOnly;			// Headless mode: geometry only, no VAO/VBO/EBO.
+		vector<SVertex>	m_cpuVertices;
+		vector<GLuint>	m_cpuIndices;
+		EVertexLayout	m_vertexLayout;
+		size_t			m_vertexBufferSize = 0;
+		// Position decoding in the vertex shaders: position = positionOffset + positionScale * attribute.
+		glm::vec3		m_positionScale = glm::vec3(1.f);
+		glm::vec3		m_positionOffset = glm::vec3(0.f);
 		const CShader&	m_shaderColorPhong;
 		const CShader&	m_shaderColorAmbient;
 		const CShader&	m_shaderTextureDiffuse;
 		const CShader&	m_shaderTextureAmbient;
+		const CShader&	m_shaderColorPhongInstanced;
+		const CShader&	m_shaderColorAmbientInstanced;
+		const CShader&	m_shaderTextureDiffuseInstanced;
+		const CShader&	m_shaderTextureAmbientInstanced;
+
+		void setupFloatVertices(const SVertex* vertices, size_t numVertices);
+		void setupPackedVertices(const SVertex* vertices, size_t numVertices);
+		// Program, texture and per-draw uniforms (same selection for both paths). False if the mesh can't be drawn.
+		bool setupDrawItem(SDrawItem& item, bool bForceAmbient, bool bInstanced, uint32_t lod) const;
+		// Draw call arguments of a lod (clamped to the coarsest one).
+		void getLodRange(uint32_t lod, GLsizei& count, const GLvoid*& offset) const;
 };
 
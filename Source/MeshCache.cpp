@@ -0,0 +1,212 @@
+#include "MeshCache.h"
+#include "StringUtil.h"
+
+// Bump when the layout below or SVertex changes.
+static constexpr char gMeshCacheMagic[4] = { 'S', 'F', 'M', 'C' };
+static constexpr uint32_t gMeshCacheVersion = 3; // 2: optimised vertex and triangle order. 3: lods.
+// The blobs start on 16 bytes boundaries.
+static constexpr size_t gMeshCacheAlignment = 16;
+
+struct SMeshCacheHeader
+{
+	char Magic[4];
+	uint32_t Version;
+	uint32_t VertexSize; // sizeof(SVertex), in case its layout changes without a version bump.
+	uint32_t NumberOfMeshes;
+	s64 SourceSize;
+	s64 SourceTime;
+	s64 WriteTime; // When the cache was written (mtimes have a 1 s resolution).
+	uint64_t SourceHash;
+	SAABB AABB;
+};
+
+// Followed by the texture references (uint32 type length, type, uint32 path length, path), the lods (SMeshLod), then the blobs.
+struct SMeshCacheMesh
+{
+	uint32_t NumberOfVertices;
+	uint32_t NumberOfIndices;
+	uint32_t NumberOfTextures;
+	uint32_t NumberOfLods;
+	uint32_t Flags;
+	glm::mat4 Colors;
+};
+
+enum EMeshCacheFlags : uint32_t { HasNormals = 1, HasTexCoords = 2, HasColors = 4 };
+
+void SMeshData::Own(vector<SVertex>&& VerticesIn, vector<GLuint>&& IndicesIn)
+{
+	OwnedVertices = std::move(VerticesIn);
+	OwnedIndices = std::move(IndicesIn);
+	Vertices = OwnedVertices.data();
+	NumberOfVertices = uint32_t(OwnedVertices.size());
+	Indices = OwnedIndices.data();
+	NumberOfIndices = uint32_t(OwnedIndices.size());
+}
+
+string CMeshCache::Directory = ROOT_DIR"Cache\\Meshes";
+
+string CMeshCache::GetCachePath(string const& SourcePath)
+{
+	// The sources of different directories may have the same name: the path is hashed (FNV-1a 64) into the cache name.
+	string const sourcePath = stringReplaceAllTokens(getCanonicalPath(SourcePath), "\\", "/");
+	uint64_t hash = 14695981039346656037ull;
+	for (char const c : sourcePath) { hash ^= uint8_t(c); hash *= 1099511628211ull; }
+	char prefix[32];
+	snprintf(prefix, sizeof(prefix), "%016llx_", (unsigned long long)hash);
+	return stringReplaceAllTokens(Directory, "\\", "/") + '/' + prefix + sourcePath.substr(sourcePath.find_last_of('/') + 1) + ".meshcache";
+}
+
+// FNV-1a of the whole source file.
+static size_t Align(size_t const Offset) { return (Offset + gMeshCacheAlignment - 1) & ~(gMeshCacheAlignment - 1); }
+
+bool CMeshCache::Open(string const& SourcePath)
+{
+	Meshes.clear();
+	string const cachePath = GetCachePath(SourcePath);
+	if (!isFileExist(cachePath) || !File.open(cachePath)) return false;
+
+	uint8_t const* const data = File.data();
+	size_t const size = File.size();
+	if (size < sizeof(SMeshCacheHeader)) return false;
+
+	SMeshCacheHeader header;
+	std::memcpy(&header, data, sizeof(header));
+	if (std::memcmp(header.Magic, gMeshCacheMagic, sizeof(gMeshCacheMagic)) != 0) return false;
+	if (header.Version != gMeshCacheVersion || header.VertexSize != sizeof(SVertex)) return false;
+
+	// Up to date?
+	if (header.SourceSize != getFileSize(SourcePath)) return false;
+	// Same second as the cache writing: the source may have been edited since, only the hash can tell.
+	s64 const sourceTime = getFileModificationTime(SourcePath);
+	if (sourceTime != header.SourceTime || sourceTime >= header.WriteTime)
+	{
+		uint64_t hash;
+		if (!getFileHash(SourcePath, hash) || hash != header.SourceHash) return false;
+	}
+	AABB = header.AABB;
+
+	// Reads a value at offset, false if out of the file.
+	size_t offset = sizeof(SMeshCacheHeader);
+	auto const read = [data, size, &offset](void* const Out, size_t const Size)
+	{
+		if (offset + Size > size) return false;
+		std::memcpy(Out, data + offset, Size);
+		offset += Size;
+		return true;
+	};
+	auto const readString = [data, size, &offset, &read](string& Out)
+	{
+		uint32_t length;
+		if (!read(&length, sizeof(length)) || offset + length > size) return false;
+		Out.assign(reinterpret_cast<char const*>(data + offset), length);
+		offset += length;
+		return true;
+	};
+
+	Meshes.resize(header.NumberOfMeshes);
+	for (SMeshData& mesh : Meshes)
+	{
+		SMeshCacheMesh meshHeader;
+		if (!read(&meshHeader, sizeof(meshHeader))) return false;
+		mesh.Colors = meshHeader.Colors;
+		mesh.bHasNormals = (meshHeader.Flags & HasNormals) != 0;
+		mesh.bHasTexCoords = (meshHeader.Flags & HasTexCoords) != 0;
+		mesh.bHasColors = (meshHeader.Flags & HasColors) != 0;
+
+		mesh.Textures.resize(meshHeader.NumberOfTextures);
+		for (STextureReference& texture : mesh.Textures)
+		{
+			if (!readString(texture.Type) || !readString(texture.Path)) return false;
+		}
+		mesh.Lods.resize(meshHeader.NumberOfLods);
+		for (SMeshLod& lod : mesh.Lods)
+		{
+			if (!read(&lod, sizeof(lod)) || size_t(lod.IndexOffset) + lod.IndexCount > meshHeader.NumberOfIndices) return false;
+		}
+
+		// The blobs are used in place.
+		offset = Align(offset);
+		size_t const verticesSize = size_t(meshHeader.NumberOfVertices) * sizeof(SVertex);
+		if (offset + verticesSize > size) return false;
+		mesh.Vertices = reinterpret_cast<SVertex const*>(data + offset);
+		mesh.NumberOfVertices = meshHeader.NumberOfVertices;
+		offset += verticesSize;
+
+		offset = Align(offset);
+		size_t const indicesSize = size_t(meshHeader.NumberOfIndices) * sizeof(GLuint);
+		if (offset + indicesSize > size) return false;
+		mesh.Indices = reinterpret_cast<GLuint const*>(data + offset);
+		mesh.NumberOfIndices = meshHeader.NumberOfIndices;
+		offset += indicesSize;
+	}
+	return true;
+}
+
+bool CMeshCache::Write(string const& SourcePath, vector<SMeshData> const& Meshes, SAABB const& AABB)
+{
+	SMeshCacheHeader header;
+	std::memset(static_cast<void*>(&header), 0, sizeof(header));
+	std::memcpy(header.Magic, gMeshCacheMagic, sizeof(gMeshCacheMagic));
+	header.Version = gMeshCacheVersion;
+	header.VertexSize = sizeof(SVertex);
+	header.NumberOfMeshes = uint32_t(Meshes.size());
+	header.SourceSize = getFileSize(SourcePath);
+	header.SourceTime = getFileModificationTime(SourcePath);
+	header.WriteTime = s64(time(nullptr));
+	if (!getFileHash(SourcePath, header.SourceHash)) return false;
+	header.AABB = AABB;
+
+	vector<uint8_t> buffer;
+	auto const write = [&buffer](void const* const Data, size_t const Size)
+	{
+		uint8_t const* const bytes = static_cast<uint8_t const*>(Data);
+		buffer.insert(buffer.end(), bytes, bytes + Size);
+	};
+	auto const writeString = [&write](string const& String)
+	{
+		uint32_t const length = uint32_t(String.size());
+		write(&length, sizeof(length));
+		write(String.data(), length);
+	};
+
+	write(&header, sizeof(header));
+	for (SMeshData const& mesh : Meshes)
+	{
+		SMeshCacheMesh meshHeader;
+		std::memset(&meshHeader, 0, sizeof(meshHeader));
+		meshHeader.NumberOfVertices = mesh.NumberOfVertices;
+		meshHeader.NumberOfIndices = mesh.NumberOfIndices;
+		meshHeader.NumberOfTextures = uint32_t(mesh.Textures.size());
+		meshHeader.NumberOfLods = uint32_t(mesh.Lods.size());
+		meshHeader.Flags = (mesh.bHasNormals ? HasNormals : 0) | (mesh.bHasTexCoords ? HasTexCoords : 0) | (mesh.bHasColors ? HasColors : 0);
+		meshHeader.Colors = mesh.Colors;
+		write(&meshHeader, sizeof(meshHeader));
+
+		for (STextureReference const& texture : mesh.Textures) { writeString(texture.Type); writeString(texture.Path); }
+		for (SMeshLod const& lod : mesh.Lods) write(&lod, sizeof(lod));
+
+		buffer.resize(Align(buffer.size()), 0);
+		write(mesh.Vertices, size_t(mesh.NumberOfVertices) * sizeof(SVertex));
+		buffer.resize(Align(buffer.size()), 0);
+		write(mesh.Indices, size_t(mesh.NumberOfIndices) * sizeof(GLuint));
+	}
+
+	// Models may be loaded concurrently (cf. CModel::LoadAsync), possibly from the same source. The file is written
+	// aside then moved in place, so that a cache mapped by another load is never overwritten.
+	static std::mutex writeMutex;
+	std::lock_guard<std::mutex> lock(writeMutex);
+	string const cachePath = GetCachePath(SourcePath);
+	string const tempPath = cachePath + ".tmp";
+	if (!createDirectories(cachePath.substr(0, cachePath.find_last_of('/'))))
+	{
+		ConsoleWriteErr("CMeshCache::Write : can't create the directory of %s", cachePath.c_str());
+		return false;
+	}
+	if (!saveFile(tempPath, buffer) || !deleteFile(cachePath) || !renameFile(tempPath, cachePath))
+	{
+		ConsoleWriteErr("CMeshCache::Write : can't write %s", cachePath.c_str());
+		deleteFile(tempPath);
+		return false;
+	}
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,66 @@
+#pragma once
+#include "Mesh.h"
+#include "FileUtil.h"
+
+// Texture of a mesh material, Path relative to the model directory.
+struct STextureReference
+{
+	string Type; // "texture_ambient", "texture_diffuse" or "texture_specular".
+	string Path;
+};
+
+// Geometry and material of one mesh, as imported by Assimp or read from a mesh cache.
+// The vertices and indices either live in OwnedVertices/OwnedIndices or point into a mapped cache file.
+struct SMeshData
+{
+	SMeshData() = default;
+	SMeshData(SMeshData&&) = default;
+	SMeshData(SMeshData const&) = delete;
+
+	SVertex const* Vertices = nullptr;
+	uint32_t NumberOfVertices = 0;
+	GLuint const* Indices = nullptr;
+	uint32_t NumberOfIndices = 0; // All the lods.
+	// Index ranges of the levels of detail, finest first (empty: a single lod).
+	vector<SMeshLod> Lods;
+
+	vector<STextureReference> Textures;
+	glm::mat4 Colors = glm::mat4(0.f);
+	bool bHasNormals = false;
+	bool bHasTexCoords = false;
+	bool bHasColors = false;
+
+	vector<SVertex> OwnedVertices;
+	vector<GLuint> OwnedIndices;
+	// Points Vertices/Indices to OwnedVertices/OwnedIndices.
+	void Own(vector<SVertex>&& VerticesIn, vector<GLuint>&& IndicesIn);
+};
+
+// Compiled mesh cache, in a cache directory out of Resources (cf. SetDirectory): a versioned binary file holding for each mesh
+// its interleaved vertex blob, index blob (all the lods), lod table, material colours and texture references, plus the model AABB.
+// It is memory-mapped and the blobs are uploaded as is. It is valid as long as the source file keeps the same size
+// and modification time, or else the same content hash (e.g. a fresh checkout touching all the files).
+// Note: the dependencies of the source (.mtl files, textures) are not tracked, delete the cache after editing them.
+class CMeshCache
+{
+public:
+	// Created when the first cache is written. ROOT_DIR/Cache/Meshes by default.
+	static void SetDirectory(string const& CacheDirectory) { Directory = CacheDirectory; }
+	// <directory>/<hash of the source path>_<source file name>.meshcache
+	static string GetCachePath(string const& SourcePath);
+
+	// Maps the cache of SourcePath. Returns false if it is missing, outdated or invalid.
+	bool Open(string const& SourcePath);
+	// Valid until the CMeshCache is destroyed.
+	vector<SMeshData> const& GetMeshes() const { return Meshes; }
+	SAABB const& GetAABB() const { return AABB; }
+
+	static bool Write(string const& SourcePath, vector<SMeshData> const& Meshes, SAABB const& AABB);
+
+private:
+	static string Directory;
+
+	CMappedFile File;
+	vector<SMeshData> Meshes;
+	SAABB AABB;
+};
\ No newline at end of file
@@ -0,0 +1,378 @@
+#include "MeshOptimizer.h"
+
+void MeshOptimizer::WeldVertices(vector<SVertex>& Vertices, vector<GLuint>& Indices)
+{
+	// Bitwise hashing and comparison: only the exact duplicates are merged (Assimp splits vertices per face).
+	struct SVertexHash
+	{
+		size_t operator()(SVertex const& Vertex) const
+		{
+			uint8_t const* const bytes = reinterpret_cast<uint8_t const*>(&Vertex);
+			uint64_t hash = 14695981039346656037ull;
+			for (size_t k = 0; k < sizeof(SVertex); k++) { hash ^= bytes[k]; hash *= 1099511628211ull; }
+			return size_t(hash);
+		}
+	};
+	struct SVertexEqual
+	{
+		bool operator()(SVertex const& a, SVertex const& b) const { return std::memcmp(&a, &b, sizeof(SVertex)) == 0; }
+	};
+
+	unordered_map<SVertex, GLuint, SVertexHash, SVertexEqual> uniqueVertices;
+	uniqueVertices.reserve(Vertices.size());
+	vector<GLuint> remap(Vertices.size());
+	vector<SVertex> welded;
+	welded.reserve(Vertices.size());
+	for (size_t k = 0; k < Vertices.size(); k++)
+	{
+		auto const inserted = uniqueVertices.emplace(Vertices[k], GLuint(welded.size()));
+		if (inserted.second) welded.push_back(Vertices[k]);
+		remap[k] = inserted.first->second;
+	}
+
+	for (GLuint& index : Indices) index = remap[index];
+	Vertices.swap(welded);
+}
+
+// Forsyth's scoring.
+static constexpr int32_t gForsythCacheSize = 32;
+
+static float GetVertexScore(int32_t const CachePosition, uint32_t const RemainingValence)
+{
+	if (RemainingValence == 0) return -1.f; // No triangle left to use it.
+
+	float score = 0.f;
+	if (CachePosition >= 0)
+	{
+		// The last triangle's vertices get a fixed score so that strips are not favoured too much.
+		if (CachePosition < 3) score = 0.75f;
+		else score = std::pow(1.f - float(CachePosition - 3) / float(gForsythCacheSize - 3), 1.5f);
+	}
+	// Bonus for the vertices with few triangles left, so that they are finished off.
+	score += 2.f * std::pow(float(RemainingValence), -0.5f);
+	return score;
+}
+
+void MeshOptimizer::OptimizeVertexCache(vector<GLuint>& Indices, size_t const NumberOfVertices)
+{
+	size_t const numberOfTriangles = Indices.size() / 3;
+	if (numberOfTriangles == 0) return;
+
+	// Vertex -> triangles adjacency (CSR).
+	vector<uint32_t> valences(NumberOfVertices, 0);
+	for (GLuint const index : Indices) valences[index]++;
+	vector<uint32_t> adjacencyOffsets(NumberOfVertices + 1, 0);
+	for (size_t v = 0; v < NumberOfVertices; v++) adjacencyOffsets[v + 1] = adjacencyOffsets[v] + valences[v];
+	vector<uint32_t> adjacency(Indices.size());
+	{
+		vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (size_t t = 0; t < numberOfTriangles; t++)
+		{
+			for (int k = 0; k < 3; k++) adjacency[fill[Indices[3 * t + k]]++] = uint32_t(t);
+		}
+	}
+
+	vector<int32_t> cachePositions(NumberOfVertices, -1);
+	vector<float> vertexScores(NumberOfVertices);
+	for (size_t v = 0; v < NumberOfVertices; v++) vertexScores[v] = GetVertexScore(-1, valences[v]);
+
+	vector<float> triangleScores(numberOfTriangles);
+	vector<bool> emitted(numberOfTriangles, false);
+	for (size_t t = 0; t < numberOfTriangles; t++)
+	{
+		triangleScores[t] = vertexScores[Indices[3 * t]] + vertexScores[Indices[3 * t + 1]] + vertexScores[Indices[3 * t + 2]];
+	}
+
+	// Removes the triangle from the adjacency of vertex v (swap within its range).
+	auto const removeAdjacency = [&](GLuint const v, uint32_t const Triangle)
+	{
+		uint32_t const begin = adjacencyOffsets[v], end = begin + valences[v];
+		for (uint32_t k = begin; k < end; k++)
+		{
+			if (adjacency[k] == Triangle) { std::swap(adjacency[k], adjacency[end - 1]); break; }
+		}
+		valences[v]--;
+	};
+
+	vector<GLuint> cache, newCache;
+	cache.reserve(gForsythCacheSize + 3);
+	newCache.reserve(gForsythCacheSize + 3);
+	vector<GLuint> result;
+	result.reserve(Indices.size());
+
+	int64_t bestTriangle = -1;
+	size_t scanCursor = 0; // Emitted triangles before it: the full scans restart from there.
+	for (size_t emittedCount = 0; emittedCount < numberOfTriangles; emittedCount++)
+	{
+		if (bestTriangle < 0)
+		{
+			// No candidate in the cache: best remaining triangle.
+			float bestScore = -FLT_MAX;
+			while (emitted[scanCursor]) scanCursor++;
+			for (size_t t = scanCursor; t < numberOfTriangles; t++)
+			{
+				if (!emitted[t] && triangleScores[t] > bestScore) { bestScore = triangleScores[t]; bestTriangle = int64_t(t); }
+			}
+		}
+
+		uint32_t const triangle = uint32_t(bestTriangle);
+		emitted[triangle] = true;
+		GLuint const* const vertices = &Indices[3 * triangle];
+		for (int k = 0; k < 3; k++) { result.push_back(vertices[k]); removeAdjacency(vertices[k], triangle); }
+
+		// LRU update: the triangle's vertices go first.
+		newCache.assign(vertices, vertices + 3);
+		for (GLuint const v : cache)
+		{
+			if (v != vertices[0] && v != vertices[1] && v != vertices[2]) newCache.push_back(v);
+		}
+		// Vertices pushed out of the cache.
+		for (size_t k = gForsythCacheSize; k < newCache.size(); k++)
+		{
+			cachePositions[newCache[k]] = -1;
+			vertexScores[newCache[k]] = GetVertexScore(-1, valences[newCache[k]]);
+		}
+		if (newCache.size() > size_t(gForsythCacheSize)) newCache.resize(gForsythCacheSize);
+		cache.swap(newCache);
+
+		// Rescoring the cached vertices and their triangles, and picking the next triangle among them.
+		for (size_t k = 0; k < cache.size(); k++)
+		{
+			cachePositions[cache[k]] = int32_t(k);
+			vertexScores[cache[k]] = GetVertexScore(int32_t(k), valences[cache[k]]);
+		}
+		bestTriangle = -1;
+		float bestScore = -FLT_MAX;
+		for (GLuint const v : cache)
+		{
+			for (uint32_t k = adjacencyOffsets[v], end = adjacencyOffsets[v] + valences[v]; k < end; k++)
+			{
+				uint32_t const t = adjacency[k];
+				float const score = vertexScores[Indices[3 * t]] + vertexScores[Indices[3 * t + 1]] + vertexScores[Indices[3 * t + 2]];
+				triangleScores[t] = score;
+				if (score > bestScore) { bestScore = score; bestTriangle = int64_t(t); }
+			}
+		}
+	}
+
+	Indices.swap(result);
+}
+
+void MeshOptimizer::OptimizeVertexFetch(vector<SVertex>& Vertices, vector<GLuint>& Indices)
+{
+	GLuint const unused = GLuint(-1);
+	vector<GLuint> remap(Vertices.size(), unused);
+	vector<SVertex> reordered;
+	reordered.reserve(Vertices.size());
+	for (GLuint& index : Indices)
+	{
+		if (remap[index] == unused) { remap[index] = GLuint(reordered.size()); reordered.push_back(Vertices[index]); }
+		index = remap[index];
+	}
+	// The vertices no triangle uses are dropped.
+	Vertices.swap(reordered);
+}
+
+float MeshOptimizer::ComputeACMR(vector<GLuint> const& Indices, size_t const NumberOfVertices, uint32_t const CacheSize)
+{
+	size_t const numberOfTriangles = Indices.size() / 3;
+	if (numberOfTriangles == 0) return 0.f;
+
+	// FIFO: a vertex is in the cache if it was inserted less than CacheSize misses ago.
+	vector<uint64_t> insertionTimes(NumberOfVertices, 0);
+	uint64_t time = CacheSize + 1; // Nothing is in the cache at first.
+	uint32_t misses = 0;
+	for (GLuint const index : Indices)
+	{
+		if (time - insertionTimes[index] > CacheSize)
+		{
+			insertionTimes[index] = time++;
+			misses++;
+		}
+	}
+	return float(misses) / float(numberOfTriangles);
+}
+
+// Symmetric 4x4 matrix: sum of the squared distances to a set of planes.
+struct SQuadric
+{
+	double a00 = 0., a01 = 0., a02 = 0., a03 = 0., a11 = 0., a12 = 0., a13 = 0., a22 = 0., a23 = 0., a33 = 0.;
+
+	void AddPlane(glm::dvec3 const& n, double const d)
+	{
+		a00 += n.x * n.x; a01 += n.x * n.y; a02 += n.x * n.z; a03 += n.x * d;
+		a11 += n.y * n.y; a12 += n.y * n.z; a13 += n.y * d;
+		a22 += n.z * n.z; a23 += n.z * d;
+		a33 += d * d;
+	}
+	SQuadric& operator+=(SQuadric const& q)
+	{
+		a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03; a11 += q.a11; a12 += q.a12; a13 += q.a13; a22 += q.a22; a23 += q.a23; a33 += q.a33;
+		return *this;
+	}
+	double Evaluate(glm::vec3 const& p) const
+	{
+		double const x = p.x, y = p.y, z = p.z;
+		double const res = a00 * x * x + 2. * a01 * x * y + 2. * a02 * x * z + 2. * a03 * x
+			+ a11 * y * y + 2. * a12 * y * z + 2. * a13 * y
+			+ a22 * z * z + 2. * a23 * z + a33;
+		return std::max(0., res);
+	}
+};
+
+void MeshOptimizer::SimplifyMesh(vector<SVertex> const& Vertices, vector<GLuint> const& Indices, size_t const TargetIndexCount, vector<GLuint>& IndicesOut, float& ErrorOut)
+{
+	size_t const numberOfVertices = Vertices.size();
+	IndicesOut = Indices;
+	ErrorOut = 0.f;
+
+	// Vertices sharing a position: any of them on a seam is locked.
+	struct SPositionHash
+	{
+		size_t operator()(glm::vec3 const& p) const
+		{
+			uint32_t bits[3]; std::memcpy(bits, &p, sizeof(bits));
+			return size_t(bits[0] * 73856093u ^ bits[1] * 19349663u ^ bits[2] * 83492791u);
+		}
+	};
+	unordered_map<glm::vec3, GLuint, SPositionHash> firstVertexAtPosition;
+	vector<GLuint> positionGroup(numberOfVertices);
+	vector<uint32_t> groupSizes(numberOfVertices, 0);
+	for (size_t v = 0; v < numberOfVertices; v++)
+	{
+		positionGroup[v] = firstVertexAtPosition.emplace(Vertices[v].Position, GLuint(v)).first->second;
+		groupSizes[positionGroup[v]]++;
+	}
+	vector<bool> locked(numberOfVertices, false);
+	for (size_t v = 0; v < numberOfVertices; v++) locked[v] = groupSizes[positionGroup[v]] > 1;
+
+	// Open borders: edges (between positions) used by a single triangle.
+	{
+		std::map<std::pair<GLuint, GLuint>, uint32_t> edgeUses;
+		for (size_t t = 0; t + 2 < Indices.size(); t += 3)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				GLuint a = positionGroup[Indices[t + k]], b = positionGroup[Indices[t + (k + 1) % 3]];
+				if (a > b) std::swap(a, b);
+				edgeUses[{ a, b }]++;
+			}
+		}
+		for (size_t t = 0; t + 2 < Indices.size(); t += 3)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				GLuint const u = Indices[t + k], w = Indices[t + (k + 1) % 3];
+				GLuint a = positionGroup[u], b = positionGroup[w];
+				if (a > b) std::swap(a, b);
+				if (edgeUses[{ a, b }] == 1) locked[u] = locked[w] = true;
+			}
+		}
+	}
+
+	// Initial quadrics: planes of the adjacent triangles.
+	vector<SQuadric> quadrics(numberOfVertices);
+	for (size_t t = 0; t + 2 < Indices.size(); t += 3)
+	{
+		glm::dvec3 const p0 = Vertices[Indices[t]].Position, p1 = Vertices[Indices[t + 1]].Position, p2 = Vertices[Indices[t + 2]].Position;
+		glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+		double const length = glm::length(normal);
+		if (length <= 0.) continue;
+		normal /= length;
+		for (int k = 0; k < 3; k++) quadrics[Indices[t + k]].AddPlane(normal, -glm::dot(normal, p0));
+	}
+
+	struct SCollapse { GLuint From, To; double Cost; };
+	vector<SCollapse> collapses;
+	vector<GLuint> remap(numberOfVertices);
+	vector<bool> touched(numberOfVertices);
+	vector<uint32_t> adjacencyOffsets(numberOfVertices + 1), adjacency;
+	double maxCost = 0.;
+
+	while (IndicesOut.size() > TargetIndexCount)
+	{
+		size_t const numberOfTriangles = IndicesOut.size() / 3;
+
+		// Vertex -> triangles.
+		std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+		for (GLuint const index : IndicesOut) adjacencyOffsets[index + 1]++;
+		for (size_t v = 0; v < numberOfVertices; v++) adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+		adjacency.resize(IndicesOut.size());
+		{
+			vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+			for (size_t t = 0; t < numberOfTriangles; t++)
+			{
+				for (int k = 0; k < 3; k++) adjacency[fill[IndicesOut[3 * t + k]]++] = uint32_t(t);
+			}
+		}
+
+		// Candidates: both directions of every edge, the moving vertex has to be free.
+		collapses.clear();
+		for (size_t t = 0; t < numberOfTriangles; t++)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				GLuint const u = IndicesOut[3 * t + k], v = IndicesOut[3 * t + (k + 1) % 3];
+				SQuadric q = quadrics[u]; q += quadrics[v];
+				if (!locked[u]) collapses.push_back({ u, v, q.Evaluate(Vertices[v].Position) });
+				if (!locked[v]) collapses.push_back({ v, u, q.Evaluate(Vertices[u].Position) });
+			}
+		}
+		if (collapses.empty()) break;
+		std::sort(collapses.begin(), collapses.end(), [](SCollapse const& a, SCollapse const& b) { return a.Cost < b.Cost; });
+
+		// Cheapest independent collapses first, up to the target.
+		for (size_t v = 0; v < numberOfVertices; v++) remap[v] = GLuint(v);
+		std::fill(touched.begin(), touched.end(), false);
+		size_t const trianglesToRemove = numberOfTriangles - TargetIndexCount / 3;
+		size_t removedTriangles = 0;
+		for (SCollapse const& collapse : collapses)
+		{
+			if (removedTriangles >= trianglesToRemove) break;
+			GLuint const u = collapse.From, v = collapse.To;
+			if (touched[u] || touched[v]) continue;
+
+			// Rejects the collapse if a remaining triangle around u would flip.
+			bool flips = false;
+			size_t collapsedTriangles = 0;
+			for (uint32_t k = adjacencyOffsets[u]; k < adjacencyOffsets[u + 1] && !flips; k++)
+			{
+				GLuint const* const triangle = &IndicesOut[3 * adjacency[k]];
+				if (triangle[0] == v || triangle[1] == v || triangle[2] == v) { collapsedTriangles++; continue; }
+				glm::vec3 p[3], q[3];
+				for (int i = 0; i < 3; i++)
+				{
+					p[i] = Vertices[triangle[i]].Position;
+					q[i] = (triangle[i] == u) ? Vertices[v].Position : p[i];
+				}
+				glm::vec3 const before = glm::cross(p[1] - p[0], p[2] - p[0]);
+				glm::vec3 const after = glm::cross(q[1] - q[0], q[2] - q[0]);
+				flips = glm::dot(before, after) <= 0.f;
+			}
+			if (flips || collapsedTriangles == 0) continue;
+
+			remap[u] = v;
+			quadrics[v] += quadrics[u];
+			maxCost = std::max(maxCost, collapse.Cost);
+			removedTriangles += collapsedTriangles;
+			// The neighbourhood changes: no other collapse around it in this pass.
+			for (uint32_t k = adjacencyOffsets[u]; k < adjacencyOffsets[u + 1]; k++)
+			{
+				for (int i = 0; i < 3; i++) touched[IndicesOut[3 * adjacency[k] + i]] = true;
+			}
+		}
+		if (removedTriangles == 0) break;
+
+		// Applying the collapses and dropping the degenerate triangles.
+		size_t write = 0;
+		for (size_t t = 0; t < numberOfTriangles; t++)
+		{
+			GLuint const a = remap[IndicesOut[3 * t]], b = remap[IndicesOut[3 * t + 1]], c = remap[IndicesOut[3 * t + 2]];
+			if (a == b || b == c || a == c) continue;
+			IndicesOut[write++] = a; IndicesOut[write++] = b; IndicesOut[write++] = c;
+		}
+		IndicesOut.resize(write);
+	}
+
+	ErrorOut = float(std::sqrt(maxCost));
+}
\ No newline at end of file
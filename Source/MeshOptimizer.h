@@ -0,0 +1,25 @@
+#pragma once
+#include "Mesh.h"
+
+// Import-time optimisations of indexed triangle lists (cf. CModel::processMesh).
+namespace MeshOptimizer
+{
+	// Merges the bitwise identical vertices and remaps the indices.
+	void WeldVertices(vector<SVertex>& Vertices, vector<GLuint>& Indices);
+
+	// Reorders the triangles for the post-transform vertex cache (Tom Forsyth's "Linear-Speed Vertex Cache Optimisation").
+	void OptimizeVertexCache(vector<GLuint>& Indices, size_t const NumberOfVertices);
+
+	// Reorders the vertices by first use in the index buffer (pre-transform cache / vertex fetch locality).
+	void OptimizeVertexFetch(vector<SVertex>& Vertices, vector<GLuint>& Indices);
+
+	// Quadric edge collapse (Garland & Heckbert) restricted to the existing vertices: returns in IndicesOut a coarser
+	// index buffer over the same vertices, with at most TargetIndexCount indices if it can get there.
+	// Vertices on open borders and on attribute seams (same position, different normal/UV) never move.
+	// ErrorOut: geometric error of the result, roughly the largest distance to the original surface (model units).
+	void SimplifyMesh(vector<SVertex> const& Vertices, vector<GLuint> const& Indices, size_t const TargetIndexCount, vector<GLuint>& IndicesOut, float& ErrorOut);
+
+	// Average cache miss ratio: transformed vertices per triangle with a FIFO cache of CacheSize entries.
+	// 3 is the worst, 0.5 the best possible on a regular grid.
+	float ComputeACMR(vector<GLuint> const& Indices, size_t const NumberOfVertices, uint32_t const CacheSize = 16);
+}
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include "Model.h"
 #include "Texture.h"
 #include "StringUtil.h"
+#include "MeshOptimizer.h"
 #include <reactphysics3d/reactphysics3d.h>
 
 rp3d::Vector3 SAABB::GetLength() const
@@ -18,72 +19,317 @@ float SAABB::GetMaxLength() const
 	return GetLength().getMaxValue();
 }
 
-CModel::CModel(const string& path) { Load(path); }
+float SAABB::GetBoundingRadius() const
+{
+	float const x = std::fmax(std::fabs(XMin), std::fabs(XMax));
+	float const y = std::fmax(std::fabs(YMin), std::fabs(YMax));
+	float const z = std::fmax(std::fabs(ZMin), std::fabs(ZMax));
+	return std::sqrt(x * x + y * y + z * z);
+}
+
+CModel::CModel(const string& path, bool const CpuOnly) { Load(path, CpuOnly); }
 
 SAABB const& CModel::GetAABB() const { return AABB; }
 
-void CModel::Draw(glm::vec3 const& CameraPosition, glm::mat4 const& ModelMatrix, glm::mat4 const& ViewMatrix, glm::mat4 const& ProjectionMatrix, glm::vec3 const& LightPosition, glm::vec3 const& LightColor, bool const ForceAmbient)
+float CModel::LodViewportHeight = 1080.f;
+float CModel::LodMaxPixelError = 1.f;
+
+float CModel::GetPixelsPerUnit(float const Distance, glm::mat4 const& ProjectionMatrix)
 {
+	// ProjectionMatrix[1][1] = 1 / tan(fovy / 2): NDC units (half a viewport) per view unit at distance 1.
+	return ProjectionMatrix[1][1] * LodViewportHeight * 0.5f / std::max(Distance, 1.f);
+}
+
+uint32_t CModel::GetNumberOfLods() const
+{
+	size_t lods = 1;
+	for (const CMesh& m : m_meshes) lods = std::max(lods, m.GetLods().size());
+	return uint32_t(lods);
+}
+
+float CModel::GetLodError(uint32_t const Lod) const
+{
+	float error = 0.f;
+	for (const CMesh& m : m_meshes)
+	{
+		const vector<SMeshLod>& lods = m.GetLods();
+		if (!lods.empty()) error = std::max(error, lods[std::min<size_t>(Lod, lods.size() - 1)].Error);
+	}
+	return error;
+}
+
+uint32_t CModel::SelectLod(float const PixelsPerUnit) const
+{
+	uint32_t lod = 0;
+	for (uint32_t candidate = 1; candidate < GetNumberOfLods(); candidate++)
+	{
+		if (GetLodError(candidate) * PixelsPerUnit > LodMaxPixelError) break;
+		lod = candidate;
+	}
+	return lod;
+}
+
+void CModel::Submit(CRenderQueue& Queue, glm::mat4 const& ModelMatrix, bool const ForceAmbient, uint32_t const Lod)
+{
+	Submit(Queue, ModelMatrix, glm::mat3(glm::transpose(glm::inverse(ModelMatrix))), ForceAmbient, Lod);
+}
+
+void CModel::Submit(CRenderQueue& Queue, glm::mat4 const& ModelMatrix, glm::mat3 const& NormalMatrix, bool const ForceAmbient, uint32_t const Lod)
+{
+	if (!IsReady())
+	{
+		// The placeholder is stretched over the bounding box of this model.
+		if (!IsLoaded() || !m_placeholder || !m_placeholder->IsReady()) return;
+		SAABB const& box = m_placeholder->GetAABB();
+		glm::vec3 const placeholderCenter(0.5f * (box.XMin + box.XMax), 0.5f * (box.YMin + box.YMax), 0.5f * (box.ZMin + box.ZMax));
+		glm::vec3 const placeholderSize(box.XMax - box.XMin, box.YMax - box.YMin, box.ZMax - box.ZMin);
+		glm::vec3 const center(0.5f * (AABB.XMin + AABB.XMax), 0.5f * (AABB.YMin + AABB.YMax), 0.5f * (AABB.ZMin + AABB.ZMax));
+		glm::vec3 const size(AABB.XMax - AABB.XMin, AABB.YMax - AABB.YMin, AABB.ZMax - AABB.ZMin);
+		glm::mat4 placeholderMatrix = glm::translate(ModelMatrix, center);
+		placeholderMatrix = glm::scale(placeholderMatrix, glm::max(size, glm::vec3(1e-3f)) / glm::max(placeholderSize, glm::vec3(1e-3f)));
+		placeholderMatrix = glm::translate(placeholderMatrix, -placeholderCenter);
+		m_placeholder->Submit(Queue, placeholderMatrix, NormalMatrix, true); // Ambient: no normals.
+		return;
+	}
 	for (auto& m : m_meshes)
 	{
-		m.Draw(CameraPosition, ModelMatrix, ViewMatrix, ProjectionMatrix, LightPosition, LightColor, ForceAmbient);
+		m.Submit(Queue, ModelMatrix, NormalMatrix, ForceAmbient, Lod);
 	}
 }
 
-bool CModel::Load(const string& path)
+void CModel::SubmitInstanced(CRenderQueue& Queue, vector<SInstanceData> const& Instances, bool const ForceAmbient, uint32_t const Lod)
+{
+	if (CpuOnly || Instances.empty() || !IsReady()) return;
+
+	if (m_InstanceVBO == 0)
+	{
+		glGenBuffers(1, &m_InstanceVBO);
+		for (auto& m : m_meshes) m.SetInstanceBuffer(m_InstanceVBO);
+	}
+
+	// All the batches of the frame go into the instance buffer, uploaded once before the queue is flushed.
+	if (m_InstanceFrameIndex != Queue.GetFrameIndex())
+	{
+		m_InstanceFrameIndex = Queue.GetFrameIndex();
+		m_FrameInstances.clear();
+		Queue.AddUpload([this]() { uploadInstances(); });
+	}
+	uint32_t const firstInstance = uint32_t(m_FrameInstances.size());
+	m_FrameInstances.insert(m_FrameInstances.end(), Instances.begin(), Instances.end());
+
+	for (auto& m : m_meshes)
+	{
+		m.SubmitInstanced(Queue, m_InstanceVBO, firstInstance, (GLsizei)Instances.size(), ForceAmbient, Lod);
+	}
+}
+
+void CModel::uploadInstances()
+{
+	// The buffer only grows, and is orphaned otherwise so that the driver does not stall on the previous frame's draws.
+	glBindBuffer(GL_ARRAY_BUFFER, m_InstanceVBO);
+	if (m_FrameInstances.size() > m_InstanceVBOCapacity)
+	{
+		m_InstanceVBOCapacity = m_FrameInstances.size();
+		glBufferData(GL_ARRAY_BUFFER, m_InstanceVBOCapacity * sizeof(SInstanceData), m_FrameInstances.data(), GL_STREAM_DRAW);
+	}
+	else
+	{
+		glBufferData(GL_ARRAY_BUFFER, m_InstanceVBOCapacity * sizeof(SInstanceData), nullptr, GL_STREAM_DRAW);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, m_FrameInstances.size() * sizeof(SInstanceData), m_FrameInstances.data());
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+bool CModel::bMeshCacheEnabled = true;
+EVertexLayout CModel::VertexLayout = EVertexLayout::Packed;
+
+bool CModel::Load(const string& path, bool const CpuOnly)
+{
+	this->CpuOnly = CpuOnly;
+	m_loadStartTime = std::chrono::steady_clock::now();
+	State = EAssetState::Loading;
+
+	if (!loadGeometry(path))
+	{
+		State = EAssetState::Failed;
+		return false;
+	}
+
+	// Headless mode: no shader to compile, just the geometry.
+	if (!CpuOnly) loadShaders();
+
+	for (const SMeshData& data : m_pending->GetMeshes()) createMesh(data);
+
+	logLoad(path);
+	m_pending.reset();
+	State = EAssetState::Ready;
+	return true;
+}
+
+void CModel::LoadAsync(const string& path, CAssetLoader& Loader)
+{
+	CpuOnly = false;
+	m_loadStartTime = std::chrono::steady_clock::now();
+	State = EAssetState::Loading;
+
+	Loader.Enqueue([this, path, &Loader]()
+	{
+		if (!loadGeometry(path))
+		{
+			State = EAssetState::Failed;
+			Loader.NotifyProgress();
+			return;
+		}
+		// The AABB is published: the entities using this model can be set up.
+		State = EAssetState::Uploading;
+		Loader.NotifyProgress();
+
+		// Decoding the textures here too (unless they are resident already), only their upload is left to the GL thread.
+		for (const SMeshData& data : m_pending->GetMeshes())
+		{
+			for (const STextureReference& reference : data.Textures)
+			{
+				if (m_pending->Textures.count(reference.Path)) continue;
+				SPendingTexture& texture = m_pending->Textures[reference.Path];
+				texture.Type = reference.Type;
+				CTextureCache::Get().Prepare(m_directory + '/' + reference.Path, texture.Prepared);
+			}
+		}
+
+		// One upload per shader set, texture and mesh, so that the budget of a frame can be respected.
+		Loader.EnqueueUpload([this]() { loadShaders(); });
+		for (auto& entry : m_pending->Textures)
+		{
+			Loader.EnqueueUpload([this, &entry]()
+			{
+				CTexture texture = CTextureCache::Get().Finish(entry.second.Prepared, GL_TEXTURE_WRAP_S, GL_TEXTURE_WRAP_T);
+				texture.m_type = entry.second.Type;
+				m_loaded_textures[entry.first] = texture;
+			});
+		}
+		for (size_t k = 0; k < m_pending->GetMeshes().size(); k++)
+		{
+			Loader.EnqueueUpload([this, k]() { createMesh(m_pending->GetMeshes()[k]); });
+		}
+		Loader.EnqueueUpload([this, path]()
+		{
+			logLoad(path);
+			m_pending.reset();
+			State = EAssetState::Ready;
+		});
+	});
+}
+
+bool CModel::loadGeometry(const string& path)
 {
 	string const curratedPath = stringReplaceAllTokens(path, "\\", "/");
+	m_directory = curratedPath.substr(0, curratedPath.find_last_of('/'));
+	m_pending = std::make_unique<SPendingLoad>();
+
+	// The compiled mesh cache spares the Assimp import. Its blobs are uploaded straight from the mapped file.
+	m_pending->CacheHit = bMeshCacheEnabled && m_pending->Cache.Open(curratedPath);
+	if (m_pending->CacheHit)
+	{
+		AABB = m_pending->Cache.GetAABB();
+		return true;
+	}
+
 	Assimp::Importer importer;
 	const aiScene* scene = importer.ReadFile(curratedPath, aiProcess_Triangulate | aiProcess_FlipUVs);
 
 	if (!scene || scene->mFlags == AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
 	{
 		ConsoleWriteErr("CModel::loadModel(%s) : failed to load. %s", path.c_str(), importer.GetErrorString());
-		Loaded = false;
+		m_pending.reset();
 		return false;
 	}
-	m_directory = curratedPath.substr(0, curratedPath.find_last_of('/'));
+	processNodes(scene->mRootNode, scene, m_pending->ImportedMeshes);
+	if (bMeshCacheEnabled) CMeshCache::Write(curratedPath, m_pending->ImportedMeshes, AABB);
+	return true;
+}
 
-	if (m_ShaderColorPhong.Load(ROOT_DIR"Resources\\Shaders\\phong.vert", ROOT_DIR"Resources\\Shaders\\phong.frag") == false)
+void CModel::logLoad(const string& path) const
+{
+	double const loadTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_loadStartTime).count();
+	ConsoleWrite("CModel::Load(%s) : %.1f ms (mesh cache %s)", path.c_str(), loadTime, m_pending->CacheHit ? "hit" : (bMeshCacheEnabled ? "miss" : "disabled"));
+	if (!CpuOnly)
+	{
+		size_t vertexBufferSize = 0, numVertices = 0;
+		for (const CMesh& mesh : m_meshes) { vertexBufferSize += mesh.GetVertexBufferSize(); numVertices += mesh.GetNumberOfVertices(); }
+		ConsoleWrite(" -> %u vertices, %.1f KB of vertex buffers (%s layout, %u KB as SVertex)", uint32_t(numVertices), vertexBufferSize / 1024.,
+			VertexLayout == EVertexLayout::Packed ? "packed" : "float", uint32_t(numVertices * sizeof(SVertex) / 1024));
+		CTextureCache const& textureCache = CTextureCache::Get();
+		ConsoleWrite(" -> %u textures resident (%.1f KB), %u uploads and %u cache hits so far", textureCache.GetNumberOfResidentTextures(),
+			textureCache.GetResidentBytes() / 1024., textureCache.GetNumberOfUploads(), textureCache.GetNumberOfHits());
+	}
+}
+
+bool CModel::loadShaders()
+{
+	bool ok = true;
+	if (!(m_ShaderColorPhong = CShaderLibrary::Get().Acquire(ROOT_DIR"Resources\\Shaders\\phong.vert", ROOT_DIR"Resources\\Shaders\\phong.frag")))
 	{
 		ConsoleWriteErr("Failed to load shader");
+		ok = false;
 	}
-	if (m_ShaderColorAmbient.Load(ROOT_DIR"Resources\\Shaders\\ambient_col.vert", ROOT_DIR"Resources\\Shaders\\ambient_col.frag") == false)
+	if (!(m_ShaderColorAmbient = CShaderLibrary::Get().Acquire(ROOT_DIR"Resources\\Shaders\\ambient_col.vert", ROOT_DIR"Resources\\Shaders\\ambient_col.frag")))
 	{
 		ConsoleWriteErr("Failed to load shader");
+		ok = false;
 	}
-	if (m_ShaderTextureDiffuse.Load(ROOT_DIR"Resources\\Shaders\\diffuse_tex.vert", ROOT_DIR"Resources\\Shaders\\diffuse_tex.frag") == false)
+	if (!(m_ShaderTextureDiffuse = CShaderLibrary::Get().Acquire(ROOT_DIR"Resources\\Shaders\\diffuse_tex.vert", ROOT_DIR"Resources\\Shaders\\diffuse_tex.frag")))
 	{
 		ConsoleWriteErr("Failed to load shader");
+		ok = false;
 	}
-	if (m_ShaderTextureAmbient.Load(ROOT_DIR"Resources\\Shaders\\ambient_tex.vert", ROOT_DIR"Resources\\Shaders\\ambient_tex.frag") == false)
+	if (!(m_ShaderTextureAmbient = CShaderLibrary::Get().Acquire(ROOT_DIR"Resources\\Shaders\\ambient_tex.vert", ROOT_DIR"Resources\\Shaders\\ambient_tex.frag")))
 	{
 		ConsoleWriteErr("Failed to load shader");
+		ok = false;
 	}
-	processNodes(scene->mRootNode, scene);
-
-	Loaded = true;
-	return true;
+	if (!(m_ShaderColorPhongInstanced = CShaderLibrary::Get().Acquire(ROOT_DIR"Resources\\Shaders\\phong_inst.vert", ROOT_DIR"Resources\\Shaders\\phong_inst.frag")))
+	{
+		ConsoleWriteErr("Failed to load shader");
+		ok = false;
+	}
+	if (!(m_ShaderColorAmbientInstanced = CShaderLibrary::Get().Acquire(ROOT_DIR"Resources\\Shaders\\ambient_col_inst.vert", ROOT_DIR"Resources\\Shaders\\ambient_col_inst.frag")))
+	{
+		ConsoleWriteErr("Failed to load shader");
+		ok = false;
+	}
+	if (!(m_ShaderTextureDiffuseInstanced = CShaderLibrary::Get().Acquire(ROOT_DIR"Resources\\Shaders\\diffuse_tex_inst.vert", ROOT_DIR"Resources\\Shaders\\diffuse_tex_inst.frag")))
+	{
+		ConsoleWriteErr("Failed to load shader");
+		ok = false;
+	}
+	if (!(m_ShaderTextureAmbientInstanced = CShaderLibrary::Get().Acquire(ROOT_DIR"Resources\\Shaders\\ambient_tex_inst.vert", ROOT_DIR"Resources\\Shaders\\ambient_tex_inst.frag")))
+	{
+		ConsoleWriteErr("Failed to load shader");
+		ok = false;
+	}
+	return ok;
 }
 
-void CModel::processNodes(const aiNode* node, const aiScene* scene)
+void CModel::processNodes(const aiNode* node, const aiScene* scene, vector<SMeshData>& meshes)
 {
 	for (GLuint i=0; i<node->mNumMeshes; ++i)
 	{
 		const aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-		processMesh(mesh, scene);
+		meshes.push_back(processMesh(mesh, scene));
 	}
 	for (GLuint i=0; i<node->mNumChildren; ++i)
 	{
-		processNodes(node->mChildren[i], scene);
+		processNodes(node->mChildren[i], scene, meshes);
 	}
 }
 
-void CModel::processMesh(const aiMesh* mesh, const aiScene* scene)
+SMeshData CModel::processMesh(const aiMesh* mesh, const aiScene* scene)
 {
+	SMeshData data;
 	vector<SVertex>	vertices;
 	vector<GLuint>	indices;
-	vector<CTexture>	textures;
+	vertices.reserve(mesh->mNumVertices);
+	indices.reserve(size_t(mesh->mNumFaces) * 3);
 
 	bool bHasNormals	= (mesh->mNormals != NULL);
 	bool bHasTexCoords	= (mesh->HasTextureCoords(0));
@@ -92,7 +338,7 @@ void CModel::processMesh(const aiMesh* mesh, const aiScene* scene)
 	// Vertices
 	for (GLuint i=0; i<mesh->mNumVertices; ++i)
 	{
-		SVertex vertex;
+		SVertex vertex = {}; // Zeroed: the welding compares whole vertices (TexCoords.z included).
 		float const x = mesh->mVertices[i].x;
 		float const y = mesh->mVertices[i].y;
 		float const z = mesh->mVertices[i].z;
@@ -153,24 +399,60 @@ void CModel::processMesh(const aiMesh* mesh, const aiScene* scene)
 		}
 	}
 
-	// Materials
-	aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+	// Import-time optimisations (the result goes into the mesh cache): welding, lod chain, then post-transform cache
+	// and vertex fetch locality. Only for pure triangle lists.
+	if (mesh->mPrimitiveTypes == aiPrimitiveType_TRIANGLE && !indices.empty())
+	{
+		size_t const numVerticesBefore = vertices.size();
+		float const acmrBefore = MeshOptimizer::ComputeACMR(indices, vertices.size());
+		MeshOptimizer::WeldVertices(vertices, indices);
+
+		// Each lod has about a quarter of the triangles of the previous one, all simplified from lod 0.
+		vector<vector<GLuint>> lodIndices(1, indices);
+		vector<float> lodErrors(1, 0.f);
+		while (lodIndices.size() < MaxNumberOfLods)
+		{
+			size_t const targetIndexCount = lodIndices.back().size() / 4 / 3 * 3;
+			if (targetIndexCount < 3 * MinLodTriangles) break;
+			vector<GLuint> simplified; float error;
+			MeshOptimizer::SimplifyMesh(vertices, indices, targetIndexCount, simplified, error);
+			if (simplified.empty() || simplified.size() * 10 > lodIndices.back().size() * 8) break; // Not worth it (locked seams...).
+			lodIndices.push_back(std::move(simplified));
+			lodErrors.push_back(error);
+		}
 
-	vector<CTexture> ambientMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_ambient");
-	textures.insert(textures.end(), ambientMaps.begin(), ambientMaps.end());
+		indices.clear();
+		for (size_t lod = 0; lod < lodIndices.size(); lod++)
+		{
+			MeshOptimizer::OptimizeVertexCache(lodIndices[lod], vertices.size());
+			SMeshLod range;
+			range.IndexOffset = uint32_t(indices.size());
+			range.IndexCount = uint32_t(lodIndices[lod].size());
+			range.Error = lodErrors[lod];
+			data.Lods.push_back(range);
+			indices.insert(indices.end(), lodIndices[lod].begin(), lodIndices[lod].end());
+		}
+		// Lod 0 comes first: the vertices end up in its order.
+		MeshOptimizer::OptimizeVertexFetch(vertices, indices);
 
-	vector<CTexture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-	textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
+		vector<GLuint> const lod0(indices.begin(), indices.begin() + data.Lods[0].IndexCount);
+		ConsoleWrite(" -> mesh %s : %u -> %u vertices, ACMR %.3f -> %.3f, %u lods", mesh->mName.C_Str(),
+			uint32_t(numVerticesBefore), uint32_t(vertices.size()), acmrBefore, MeshOptimizer::ComputeACMR(lod0, vertices.size()), uint32_t(data.Lods.size()));
+		for (size_t lod = 1; lod < data.Lods.size(); lod++)
+		{
+			ConsoleWrite("    lod %u : %u triangles, error %g", uint32_t(lod), data.Lods[lod].IndexCount / 3, data.Lods[lod].Error);
+		}
+	}
 
-	vector<CTexture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-	textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+	// Materials
+	aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
 
-	bool bHasAmbientTex  = !ambientMaps.empty();
-	bool bHasDiffuseTex  = !diffuseMaps.empty();
-	bool bHasSpecularTex = !specularMaps.empty();
+	getMaterialTextures(material, aiTextureType_AMBIENT, "texture_ambient", data.Textures);
+	getMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse", data.Textures);
+	getMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular", data.Textures);
 
 	glm::mat4 colors(0);
-	if (ambientMaps.empty() && diffuseMaps.empty() && specularMaps.empty())
+	if (data.Textures.empty())
 	{
 		// No texture, color material
 		aiColor3D colorAmbi(0.25f,0.25f,0.25f);
@@ -189,32 +471,67 @@ void CModel::processMesh(const aiMesh* mesh, const aiScene* scene)
 		colors[3][0] = shininess;
 	}
 
-	m_meshes.push_back(CMesh(vertices, indices, textures, colors, 
-							bHasNormals, bHasTexCoords, bHasColors, 
-							bHasAmbientTex, bHasDiffuseTex, bHasSpecularTex,
-							m_ShaderColorPhong, m_ShaderColorAmbient, m_ShaderTextureDiffuse, m_ShaderTextureAmbient));
+	data.Colors = colors;
+	data.bHasNormals = bHasNormals;
+	data.bHasTexCoords = bHasTexCoords;
+	data.bHasColors = bHasColors;
+	data.Own(std::move(vertices), std::move(indices));
+	return data;
 }
 
-vector<CTexture> CModel::loadMaterialTextures(aiMaterial* mat, int aiTexType, const string& type_name)
+void CModel::getMaterialTextures(aiMaterial* mat, int aiTexType, const string& type_name, vector<STextureReference>& textures)
 {
 	aiTextureType type = (aiTextureType)aiTexType;
-	vector<CTexture> textures;
 	for (GLuint i=0; i<mat->GetTextureCount(type); ++i)
 	{
 		aiString str;
 		mat->GetTexture(type, i, &str);
-		auto iter = m_loaded_textures.find(str.C_Str());
+		STextureReference reference;
+		reference.Type = type_name;
+		reference.Path = str.C_Str();
+		textures.push_back(reference);
+	}
+}
+
+void CModel::createMesh(const SMeshData& data)
+{
+	bool bHasAmbientTex = false, bHasDiffuseTex = false, bHasSpecularTex = false;
+	for (const STextureReference& reference : data.Textures)
+	{
+		bHasAmbientTex  |= (reference.Type == "texture_ambient");
+		bHasDiffuseTex  |= (reference.Type == "texture_diffuse");
+		bHasSpecularTex |= (reference.Type == "texture_specular");
+	}
+	// Headless mode (or failed build): the meshes still need a program to refer to.
+	auto const shader = [](const std::shared_ptr<CShader>& program) -> const CShader& { static const CShader none; return program ? *program : none; };
+
+	m_meshes.push_back(CMesh(data.Vertices, data.NumberOfVertices, data.Indices, data.NumberOfIndices, data.Lods,
+							loadTextures(data.Textures), data.Colors,
+							data.bHasNormals, data.bHasTexCoords, data.bHasColors,
+							bHasAmbientTex, bHasDiffuseTex, bHasSpecularTex,
+							shader(m_ShaderColorPhong), shader(m_ShaderColorAmbient), shader(m_ShaderTextureDiffuse), shader(m_ShaderTextureAmbient),
+							shader(m_ShaderColorPhongInstanced), shader(m_ShaderColorAmbientInstanced), shader(m_ShaderTextureDiffuseInstanced), shader(m_ShaderTextureAmbientInstanced),
+							CpuOnly, VertexLayout));
+}
+
+vector<CTexture> CModel::loadTextures(const vector<STextureReference>& references)
+{
+	vector<CTexture> textures;
+	// Headless mode: no image decoding, no GL texture.
+	if (CpuOnly) return textures;
+	for (const STextureReference& reference : references)
+	{
+		auto iter = m_loaded_textures.find(reference.Path);
 		if (iter != m_loaded_textures.end())
 		{
 			textures.push_back(iter->second);
 			continue;
 		}
 
-		CTexture texture;
-		texture.Load(m_directory + '/' + str.C_Str(), GL_TEXTURE_WRAP_S, GL_TEXTURE_WRAP_T);
-		texture.m_type = type_name;
+		CTexture texture = CTextureCache::Get().Acquire(m_directory + '/' + reference.Path, GL_TEXTURE_WRAP_S, GL_TEXTURE_WRAP_T);
+		texture.m_type = reference.Type;
 		textures.push_back(texture);
-		m_loaded_textures[str.C_Str()] = texture;
+		m_loaded_textures[reference.Path] = texture;
 	}
 	return textures;
 }
@@ -2,6 +2,9 @@
 #include "Axes.h"
 #include "Mesh.h"
 #include "Shader.h"
+#include "MeshCache.h"
+#include "AssetLoader.h"
+#include "RenderQueue.h"
 #include <reactphysics3d/reactphysics3d.h>
 
 class aiNode;
@@ -9,41 +12,122 @@ class aiMesh;
 class aiMaterial;
 class aiScene;
 
-struct SAABB 
+// Loading stages of a CModel.
+enum class EAssetState : uint8_t
 {
-	float XMin = 0.f, XMax = 0.f, YMin = 0.f, YMax = 0.f, ZMin = 0.f, ZMax = 0.f;
-	rp3d::Vector3 GetLength() const;
-	float GetMaxLength() const;
+	Unloaded,
+	Loading,	// Reading the mesh cache or importing, on a loader thread.
+	Failed,
+	Uploading,	// Geometry and AABB available, GL resources on their way.
+	Ready
 };
 
 class CModel
 {
 	public:
 		CModel() = default;
-		CModel(const string& path);
+		CModel(const string& path, bool const CpuOnly = false);
 
-		bool Load(const string& path);
-		bool IsLoaded() const { return Loaded; }
+		// CpuOnly = headless mode: only the geometry and the AABB are loaded (no shader, no texture, no VAO).
+		bool Load(const string& path, bool const CpuOnly = false);
+		// Imports the model and decodes its textures on a Loader thread, then creates its GL resources through
+		// Loader's uploads. Until it is ready, the model draws its placeholder (if any) in its bounding box.
+		void LoadAsync(const string& path, CAssetLoader& Loader);
+		EAssetState GetState() const { return State.load(); }
+		// The geometry and the AABB are available (the GL resources may not be yet).
+		bool IsLoaded() const { EAssetState const state = GetState(); return state == EAssetState::Uploading || state == EAssetState::Ready; }
+		bool IsReady() const { return GetState() == EAssetState::Ready; }
+		bool IsCpuOnly() const { return CpuOnly; }
+		void SetPlaceholder(CModel* const Placeholder) { m_placeholder = Placeholder; }
 
-		void Draw(glm::vec3 const& CameraPosition, glm::mat4 const& ModelMatrix, glm::mat4 const& ViewMatrix, glm::mat4 const& ProjectionMatrix, glm::vec3 const& LightPosition, glm::vec3 const& LightColor, bool const ForceAmbient = false);
+		// The mesh cache (cf. CMeshCache) is used by default. Disable it to always import with Assimp.
+		static void SetMeshCacheEnabled(bool const Enabled) { bMeshCacheEnabled = Enabled; }
+		// Layout of the vertex buffers of the models loaded afterwards (packed by default).
+		static void SetVertexLayout(EVertexLayout const Layout) { VertexLayout = Layout; }
+
+		// Screen-space error selection: a lod is used when its geometric error covers at most MaxPixelError pixels
+		// of a viewport of height ViewportHeight (1 pixel of a 1080 pixels high viewport by default).
+		static void SetLodViewportHeight(float const ViewportHeight) { LodViewportHeight = ViewportHeight; }
+		static void SetLodMaxPixelError(float const MaxPixelError) { LodMaxPixelError = MaxPixelError; }
+		// Pixels covered by one model unit at Distance from the camera.
+		static float GetPixelsPerUnit(float const Distance, glm::mat4 const& ProjectionMatrix);
+
+		uint32_t GetNumberOfLods() const;
+		float GetLodError(uint32_t const Lod) const; // Largest error of the meshes at this lod (model units).
+		// Coarsest lod whose error stays below the pixel threshold, given the pixels covered by one model unit.
+		uint32_t SelectLod(float const PixelsPerUnit) const;
+
+		// NormalMatrix is the inverse-transpose of ModelMatrix (up to a scale), shared by all the meshes.
+		void Submit(CRenderQueue& Queue, glm::mat4 const& ModelMatrix, glm::mat3 const& NormalMatrix, bool const ForceAmbient = false, uint32_t const Lod = 0);
+		// Same, computing the normal matrix of any model matrix.
+		void Submit(CRenderQueue& Queue, glm::mat4 const& ModelMatrix, bool const ForceAmbient = false, uint32_t const Lod = 0);
+		// All the instances are drawn with one glDrawElementsInstanced per mesh.
+		void SubmitInstanced(CRenderQueue& Queue, vector<SInstanceData> const& Instances, bool const ForceAmbient = false, uint32_t const Lod = 0);
 		
 		SAABB const& GetAABB() const;
 		const vector<CMesh>& getMeshs() const; // Should be private.
 
 	private:
-		bool Loaded = false;
+		std::atomic<EAssetState> State{ EAssetState::Unloaded };
+		bool CpuOnly = false;
+		CModel* m_placeholder = nullptr;
+		std::chrono::steady_clock::time_point m_loadStartTime;
+
+		// What the loader threads hand over to the uploads, released once the model is ready.
+		struct SPendingTexture
+		{
+			string						Type;
+			CTextureCache::SPrepared	Prepared;
+		};
+		struct SPendingLoad
+		{
+			CMeshCache					Cache;
+			bool						CacheHit = false;
+			vector<SMeshData>			ImportedMeshes;
+			map<string, SPendingTexture> Textures; // By path.
+			const vector<SMeshData>& GetMeshes() const { return CacheHit ? Cache.GetMeshes() : ImportedMeshes; }
+		};
+		std::unique_ptr<SPendingLoad> m_pending;
 
 		vector<CMesh>			m_meshes;
 		string					m_directory;
-		map<string, CTexture>	m_loaded_textures;
-		CShader					m_ShaderColorPhong;
-		CShader					m_ShaderColorAmbient;
-		CShader					m_ShaderTextureDiffuse;
-		CShader					m_ShaderTextureAmbient;
+		map<string, CTexture>	m_loaded_textures; // By reference path, handles on the CTextureCache.
+		// Shared with the other models through the CShaderLibrary.
+		std::shared_ptr<CShader>	m_ShaderColorPhong;
+		std::shared_ptr<CShader>	m_ShaderColorAmbient;
+		std::shared_ptr<CShader>	m_ShaderTextureDiffuse;
+		std::shared_ptr<CShader>	m_ShaderTextureAmbient;
+		std::shared_ptr<CShader>	m_ShaderColorPhongInstanced;
+		std::shared_ptr<CShader>	m_ShaderColorAmbientInstanced;
+		std::shared_ptr<CShader>	m_ShaderTextureDiffuseInstanced;
+		std::shared_ptr<CShader>	m_ShaderTextureAmbientInstanced;
+
+		// Instance buffer (SInstanceData) shared by all the meshes of the model. Created on the first SubmitInstanced.
+		GLuint					m_InstanceVBO = 0;
+		size_t					m_InstanceVBOCapacity = 0; // In number of instances.
+		// Instances of all the batches submitted during the frame m_InstanceFrameIndex of the render queue.
+		vector<SInstanceData>	m_FrameInstances;
+		uint32_t				m_InstanceFrameIndex = 0;
+		void					uploadInstances();
 
 		SAABB AABB;
 
-		void processNodes(const aiNode* node, const aiScene* scene);
-		void processMesh(const aiMesh* mesh, const aiScene* scene);
-		vector<CTexture> loadMaterialTextures(aiMaterial* mat, int aiTexType, const string& type_name);
+		static bool bMeshCacheEnabled;
+		static EVertexLayout VertexLayout;
+		static float LodViewportHeight;
+		static float LodMaxPixelError;
+
+		// Lod chain built at import: each lod has about a quarter of the triangles of the previous one.
+		static constexpr size_t MaxNumberOfLods = 4;
+		static constexpr size_t MinLodTriangles = 32;
+
+		// Fills m_pending and AABB from the mesh cache or Assimp. No GL call.
+		bool loadGeometry(const string& path);
+		void logLoad(const string& path) const;
+		bool loadShaders();
+		void processNodes(const aiNode* node, const aiScene* scene, vector<SMeshData>& meshes);
+		SMeshData processMesh(const aiMesh* mesh, const aiScene* scene);
+		void getMaterialTextures(aiMaterial* mat, int aiTexType, const string& type_name, vector<STextureReference>& textures);
+		void createMesh(const SMeshData& data);
+		vector<CTexture> loadTextures(const vector<STextureReference>& references);
 };
@@ -0,0 +1,150 @@
+#include "PhysicsThread.h"
+
+CPhysicsThread::CPhysicsThread(rp3d::PhysicsWorld* const World, CCollisionListener& Listener, float const Dt) :
+	World(World),
+	Listener(Listener),
+	Dt(Dt)
+{
+	assert(World);
+	assert(Dt > 0.f);
+}
+
+CPhysicsThread::~CPhysicsThread()
+{
+	if (!Thread.joinable()) return;
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		Quit = true;
+	}
+	Condition.notify_one();
+	Thread.join();
+}
+
+void CPhysicsThread::Start(bool const Threaded)
+{
+	assert(!Thread.joinable());
+	if (Threaded) Thread = std::thread(&CPhysicsThread::ThreadLoop, this);
+}
+
+uint32_t CPhysicsThread::AddBody(rp3d::RigidBody* const Body)
+{
+	assert(IsIdle());
+	if (!Body) return InvalidSlot;
+	Bodies.push_back(Body);
+	return uint32_t(Bodies.size() - 1);
+}
+
+void CPhysicsThread::RemoveBody(uint32_t const Slot)
+{
+	assert(IsIdle());
+	if (Slot < Bodies.size()) Bodies[Slot] = nullptr;
+}
+
+void CPhysicsThread::Execute(FCommand&& Command)
+{
+	// Once a command is queued, the next ones have to wait too: they run in order.
+	if (PendingCommands.empty() && IsIdle()) Command();
+	else PendingCommands.push_back(std::move(Command));
+}
+
+void CPhysicsThread::Step(uint32_t const NumberOfSteps)
+{
+	if (NumberOfSteps == 0 && PendingCommands.empty()) return;
+	StepsRequested += NumberOfSteps;
+
+	if (!IsThreaded())
+	{
+		SBatch batch;
+		batch.Commands.swap(PendingCommands);
+		batch.Steps = NumberOfSteps;
+		RunBatch(batch);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		for (FCommand& command : PendingCommands) NextBatch.Commands.push_back(std::move(command));
+		NextBatch.Steps += NumberOfSteps;
+		NextBatch.Index = ++BatchesSubmitted;
+		HasNextBatch = true;
+	}
+	PendingCommands.clear();
+	Condition.notify_one();
+}
+
+SPhysicsSnapshot const& CPhysicsThread::AcquireSnapshot(bool& IsNew)
+{
+	IsNew = (ReadyIndex.load(std::memory_order_relaxed) & FreshBit) != 0;
+	if (IsNew) FrontIndex = ReadyIndex.exchange(FrontIndex, std::memory_order_acq_rel) & IndexMask;
+	return Snapshots[FrontIndex];
+}
+
+void CPhysicsThread::ThreadLoop()
+{
+	SBatch batch;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(Mutex);
+			Condition.wait(lock, [this]() { return HasNextBatch || Quit; });
+			if (Quit) return;
+			std::swap(batch, NextBatch);
+			HasNextBatch = false;
+		}
+		RunBatch(batch);
+		BatchesCompleted.store(batch.Index, std::memory_order_release);
+
+		// Keeps the capacity of the command list.
+		batch.Commands.clear();
+		batch.Steps = 0;
+	}
+}
+
+void CPhysicsThread::RunBatch(SBatch& Batch)
+{
+	for (FCommand& command : Batch.Commands) command();
+	if (Batch.Steps == 0) return;
+
+	SPhysicsSnapshot& snapshot = Snapshots[BackIndex];
+	if (!CarryOver)
+	{
+		snapshot.Events.clear();
+		snapshot.Substeps = 0;
+		snapshot.ContactPairs = 0;
+		snapshot.StepTime = 0.;
+	}
+	snapshot.Bodies.resize(Bodies.size());
+	Listener.ResetCounters();
+
+	std::chrono::steady_clock::time_point const startTime = std::chrono::steady_clock::now();
+	for (uint32_t step = 0; step < Batch.Steps; step++)
+	{
+		// The game interpolates over the last step only.
+		if (step + 1 == Batch.Steps)
+		{
+			for (size_t slot = 0; slot < Bodies.size(); slot++)
+			{
+				if (Bodies[slot]) snapshot.Bodies[slot].Previous = Bodies[slot]->getTransform();
+			}
+		}
+		World->update(Dt);
+	}
+	for (size_t slot = 0; slot < Bodies.size(); slot++)
+	{
+		if (Bodies[slot]) snapshot.Bodies[slot].Current = Bodies[slot]->getTransform();
+	}
+	StepsSimulated += Batch.Steps;
+
+	snapshot.StepIndex = StepsSimulated;
+	vector<SContactEvent>& events = Listener.GetEvents();
+	snapshot.Events.insert(snapshot.Events.end(), events.begin(), events.end());
+	events.clear();
+	snapshot.Substeps += Batch.Steps;
+	snapshot.ContactPairs += Listener.GetNumberOfContactPairs();
+	snapshot.StepTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+
+	// Publishing. Getting back a snapshot the game never acquired: it was skipped, its events are still to be handled.
+	uint32_t const previous = ReadyIndex.exchange(BackIndex | FreshBit, std::memory_order_acq_rel);
+	BackIndex = previous & IndexMask;
+	CarryOver = (previous & FreshBit) != 0;
+}
\ No newline at end of file
@@ -0,0 +1,111 @@
+#pragma once
+#include "Types.h"
+#include "CollisionListener.h"
+#include <reactphysics3d/reactphysics3d.h>
+
+// What the game gets back from the physics: the transforms of the bodies before and after the last step of a batch
+// (cf. CEntity::UpdateTransformFromPhysics) and what happened since the previous snapshot it read.
+struct SPhysicsSnapshot
+{
+	struct SBody
+	{
+		rp3d::Transform Previous = rp3d::Transform::identity();
+		rp3d::Transform Current = rp3d::Transform::identity();
+	};
+	// Steps simulated when it was taken, 0 before the first step.
+	uint64_t StepIndex = 0;
+	// By body slot (cf. CPhysicsThread::AddBody).
+	vector<SBody> Bodies;
+
+	// Since the previous snapshot read by the game (the ones it skipped included).
+	vector<SContactEvent> Events;
+	uint32_t Substeps = 0;
+	uint32_t ContactPairs = 0;
+	double StepTime = 0.; // In ms.
+};
+
+// Steps a physics world on a dedicated thread, so that the frame does not wait for it, or inline on the game thread
+// (headless runs and recordings, which have to be deterministic).
+// At runtime, the game never touches the world directly: its changes are queued as commands (Execute) and run in
+// order, before the steps requested after them. The simulation is then the same whether threaded or not.
+// The transforms come back through a triple buffer of snapshots: publishing and acquiring one is an atomic exchange,
+// the game reads the bodies without any lock.
+class CPhysicsThread
+{
+public:
+	using FCommand = std::function<void()>;
+
+	CPhysicsThread(rp3d::PhysicsWorld* const World, CCollisionListener& Listener, float const Dt);
+	// Drops the steps not run yet.
+	~CPhysicsThread();
+
+	CPhysicsThread(CPhysicsThread const&) = delete;
+	CPhysicsThread& operator=(CPhysicsThread const&) = delete;
+
+	// Steps inline until then. Call once, after the bodies are added.
+	void Start(bool const Threaded);
+	bool IsThreaded() const { return Thread.joinable(); }
+
+	// Bodies whose transforms are published, game thread and physics idle only (construction).
+	// Returns the slot of the body in SPhysicsSnapshot::Bodies (InvalidSlot for a null body).
+	static constexpr uint32_t InvalidSlot = ~0u;
+	uint32_t AddBody(rp3d::RigidBody* const Body);
+	void RemoveBody(uint32_t const Slot);
+
+	// Game thread only.
+	// Runs Command right away if the physics is idle, otherwise before the steps of the next Step.
+	void Execute(FCommand&& Command);
+	// Simulates NumberOfSteps more steps, after the commands queued until now. Returns once they are done if inline.
+	// If the physics thread has not started the previous batch yet, they are merged.
+	void Step(uint32_t const NumberOfSteps);
+	// The snapshots with a bigger StepIndex are taken after the commands executed until now.
+	uint64_t GetStepsRequested() const { return StepsRequested; }
+	// Latest snapshot, stays valid (and unchanged) until the next call. IsNew is false if it was already returned:
+	// its events and counters are only to be handled once.
+	SPhysicsSnapshot const& AcquireSnapshot(bool& IsNew);
+
+private:
+	rp3d::PhysicsWorld* const World;
+	CCollisionListener& Listener;
+	float const Dt;
+
+	// Indexed by slot, null once removed.
+	vector<rp3d::RigidBody*> Bodies;
+
+	struct SBatch
+	{
+		vector<FCommand> Commands;
+		uint32_t Steps = 0;
+		uint64_t Index = 0; // The last Step call merged into it.
+	};
+	// Game thread: commands waiting for the next Step, batches submitted.
+	vector<FCommand> PendingCommands;
+	uint64_t StepsRequested = 0;
+	uint64_t BatchesSubmitted = 0;
+	// The batch the physics thread has not started yet.
+	std::mutex Mutex;
+	std::condition_variable Condition;
+	SBatch NextBatch;
+	bool HasNextBatch = false;
+	bool Quit = false;
+	// Index of the last batch done: the game thread may touch the world once it reaches BatchesSubmitted.
+	std::atomic<uint64_t> BatchesCompleted{ 0 };
+	std::thread Thread;
+
+	// Triple buffer: the physics thread fills Snapshots[BackIndex], then exchanges it with the ready one, which the
+	// game thread exchanges with its Snapshots[FrontIndex] when it acquires. FreshBit: not acquired yet.
+	static constexpr uint32_t IndexMask = 3, FreshBit = 4;
+	SPhysicsSnapshot Snapshots[3];
+	uint32_t BackIndex = 0;
+	std::atomic<uint32_t> ReadyIndex{ 1 };
+	uint32_t FrontIndex = 2;
+	// The snapshot the physics thread got back was never acquired: its events and counters are carried over.
+	bool CarryOver = false;
+	// Physics thread.
+	uint64_t StepsSimulated = 0;
+
+	bool IsIdle() const { return BatchesCompleted.load(std::memory_order_acquire) == BatchesSubmitted; }
+	void ThreadLoop();
+	// Runs the commands then the steps, and publishes a snapshot if there was any step.
+	void RunBatch(SBatch& Batch);
+};
\ No newline at end of file
@@ -0,0 +1,164 @@
+#include "Profiler.h"
+#include "FileUtil.h"
+
+CProfiler& CProfiler::Get()
+{
+	static CProfiler profiler;
+	return profiler;
+}
+
+CProfiler::CProfiler() : StartTime(std::chrono::steady_clock::now())
+{
+	Frames.resize(NumberOfFrames);
+	OpenCpuScopes.reserve(16);
+}
+
+double CProfiler::GetTime() const
+{
+	return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - StartTime).count();
+}
+
+void CProfiler::SetGpuTimingsEnabled(bool const Enabled)
+{
+	if (!Enabled && bGpuTimingsEnabled) ReleaseGpuQueries();
+	bGpuTimingsEnabled = Enabled;
+}
+
+void CProfiler::BeginFrame()
+{
+	if (!bEnabled) return;
+	assert(!bInFrame);
+	bInFrame = true;
+
+	FrameIndex++;
+	SFrame& frame = GetCurrentFrame();
+	frame.Index = FrameIndex;
+	frame.Start = GetTime();
+	frame.Duration = 0.;
+	frame.CpuEvents.clear();
+	frame.GpuEvents.clear();
+
+	// The queries slot of this frame was last used GpuLatency frames ago: its results should be ready.
+	if (bGpuTimingsEnabled && FrameIndex > GpuLatency) ReadBackGpuQueries(FrameIndex - GpuLatency);
+}
+
+void CProfiler::EndFrame()
+{
+	if (!bEnabled || !bInFrame) return;
+	assert(OpenCpuScopes.empty() && !bGpuScopeOpen);
+	SFrame& frame = GetCurrentFrame();
+	frame.Duration = GetTime() - frame.Start;
+	bInFrame = false;
+}
+
+void CProfiler::BeginCpuScope(char const* const Name)
+{
+	if (!bInFrame) return;
+	SFrame& frame = GetCurrentFrame();
+	OpenCpuScopes.push_back(uint32_t(frame.CpuEvents.size()));
+	SEvent event;
+	event.Name = Name;
+	event.Start = GetTime();
+	frame.CpuEvents.push_back(event);
+}
+
+void CProfiler::EndCpuScope()
+{
+	if (!bInFrame || OpenCpuScopes.empty()) return;
+	SEvent& event = GetCurrentFrame().CpuEvents[OpenCpuScopes.back()];
+	event.Duration = GetTime() - event.Start;
+	OpenCpuScopes.pop_back();
+}
+
+void CProfiler::BeginGpuScope(char const* const Name)
+{
+	if (!bInFrame || !bGpuTimingsEnabled) return;
+	assert(!bGpuScopeOpen);
+
+	SGpuQuery query;
+	if (FreeGpuQueries.empty()) glGenQueries(1, &query.Query);
+	else { query.Query = FreeGpuQueries.back(); FreeGpuQueries.pop_back(); }
+	query.Name = Name;
+	query.CpuStart = GetTime();
+
+	glBeginQuery(GL_TIME_ELAPSED, query.Query);
+	GpuQueries[FrameIndex % GpuLatency].push_back(query);
+	bGpuScopeOpen = true;
+}
+
+void CProfiler::EndGpuScope()
+{
+	if (!bGpuScopeOpen) return;
+	glEndQuery(GL_TIME_ELAPSED);
+	bGpuScopeOpen = false;
+}
+
+void CProfiler::ReadBackGpuQueries(uint64_t const OfFrame)
+{
+	vector<SGpuQuery>& queries = GpuQueries[OfFrame % GpuLatency];
+	// The frame may have left the ring buffer already (can't happen with GpuLatency < NumberOfFrames, but still).
+	SFrame* const frame = (FrameIndex - OfFrame < NumberOfFrames) ? &Frames[OfFrame % NumberOfFrames] : nullptr;
+
+	double gpuTime = 0.;
+	for (SGpuQuery const& query : queries)
+	{
+		GLuint available = 0;
+		glGetQueryObjectuiv(query.Query, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available && frame && frame->Index == OfFrame)
+		{
+			GLuint64 elapsed = 0; // In ns.
+			glGetQueryObjectui64v(query.Query, GL_QUERY_RESULT, &elapsed);
+			// The GPU executes the scopes in order: laying them out one after the other.
+			SEvent event;
+			event.Name = query.Name;
+			event.Start = std::max(query.CpuStart, gpuTime);
+			event.Duration = 1e-3 * double(elapsed);
+			gpuTime = event.Start + event.Duration;
+			frame->GpuEvents.push_back(event);
+		}
+		FreeGpuQueries.push_back(query.Query);
+	}
+	queries.clear();
+}
+
+void CProfiler::ReleaseGpuQueries()
+{
+	for (vector<SGpuQuery>& queries : GpuQueries)
+	{
+		for (SGpuQuery const& query : queries) FreeGpuQueries.push_back(query.Query);
+		queries.clear();
+	}
+	if (!FreeGpuQueries.empty()) glDeleteQueries(GLsizei(FreeGpuQueries.size()), FreeGpuQueries.data());
+	FreeGpuQueries.clear();
+}
+
+bool CProfiler::SaveChromeTrace(string const& Path) const
+{
+	string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	json += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":0,\"args\":{\"name\":\"CPU\"}},\n";
+	json += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":1,\"args\":{\"name\":\"GPU\"}}";
+
+	char line[256];
+	auto const addEvent = [&json, &line](char const* const Name, double const Start, double const Duration, int const Thread)
+	{
+		snprintf(line, sizeof(line), ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", Name, Thread, Start, Duration);
+		json += line;
+	};
+
+	// Oldest frame first.
+	uint32_t numberOfFrames = 0;
+	for (uint64_t index = (FrameIndex > NumberOfFrames ? FrameIndex - NumberOfFrames + 1 : 1); index <= FrameIndex; index++)
+	{
+		SFrame const& frame = Frames[index % NumberOfFrames];
+		if (frame.Index != index) continue;
+		addEvent("Frame", frame.Start, frame.Duration, 0);
+		for (SEvent const& event : frame.CpuEvents) addEvent(event.Name, event.Start, event.Duration, 0);
+		for (SEvent const& event : frame.GpuEvents) addEvent(event.Name, event.Start, event.Duration, 1);
+		numberOfFrames++;
+	}
+	json += "\n]}\n";
+
+	if (!saveFile(Path, json)) { ConsoleWriteErr("CProfiler::SaveChromeTrace : can't write %s", Path.c_str()); return false; }
+	ConsoleWriteOk("Profiler: %u frames written to %s", numberOfFrames, Path.c_str());
+	return true;
+}
\ No newline at end of file
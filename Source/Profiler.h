@@ -0,0 +1,105 @@
+#pragma once
+#include "Types.h"
+
+// Frame profiler: scoped CPU timers and optional GPU timer queries (GL_TIME_ELAPSED),
+// recorded for the last NumberOfFrames frames and dumpable as a Chrome trace (chrome://tracing, Perfetto).
+// Disabled by default: the scopes then cost a branch. Main thread only.
+class CProfiler
+{
+public:
+	static CProfiler& Get();
+
+	void SetEnabled(bool const Enabled) { bEnabled = Enabled; }
+	bool IsEnabled() const { return bEnabled; }
+	// Needs a current OpenGL context. Without it (headless), the GPU scopes do nothing.
+	void SetGpuTimingsEnabled(bool const Enabled);
+	bool AreGpuTimingsEnabled() const { return bGpuTimingsEnabled; }
+
+	// Brackets a frame: the scopes are recorded into the current frame.
+	void BeginFrame();
+	void EndFrame();
+
+	// Prefer the scoped versions below. Name has to be a string literal (or outlive the profiler).
+	void BeginCpuScope(char const* const Name);
+	void EndCpuScope();
+	// GPU scopes can't be nested (a single GL_TIME_ELAPSED query can be active at a time).
+	void BeginGpuScope(char const* const Name);
+	void EndGpuScope();
+
+	// Writes the recorded frames as Chrome trace JSON.
+	bool SaveChromeTrace(string const& Path) const;
+
+private:
+	CProfiler();
+
+	struct SEvent
+	{
+		char const* Name = nullptr;
+		double Start = 0.; // In us since the profiler creation.
+		double Duration = 0.; // In us.
+	};
+	struct SFrame
+	{
+		uint64_t Index = 0;
+		double Start = 0.;
+		double Duration = 0.;
+		vector<SEvent> CpuEvents;
+		// Filled a few frames later, once the queries results are available.
+		vector<SEvent> GpuEvents;
+	};
+	// A GL_TIME_ELAPSED query in flight.
+	struct SGpuQuery
+	{
+		GLuint Query = 0;
+		char const* Name = nullptr;
+		double CpuStart = 0.; // The GPU events are laid out from the CPU time of their submission.
+	};
+
+	static constexpr uint32_t NumberOfFrames = 300;
+	// Frames before reading back the GPU queries (avoids stalling the pipeline).
+	static constexpr uint32_t GpuLatency = 4;
+
+	bool bEnabled = false;
+	bool bGpuTimingsEnabled = false;
+	bool bInFrame = false;
+
+	std::chrono::steady_clock::time_point const StartTime;
+	double GetTime() const; // In us.
+
+	vector<SFrame> Frames; // Ring buffer.
+	uint64_t FrameIndex = 0; // Of the current frame.
+	SFrame& GetCurrentFrame() { return Frames[FrameIndex % NumberOfFrames]; }
+
+	// Indexes in the current frame CpuEvents of the open CPU scopes.
+	vector<uint32_t> OpenCpuScopes;
+
+	// GPU queries per frame in flight, plus a free list of query objects.
+	vector<SGpuQuery> GpuQueries[GpuLatency];
+	vector<GLuint> FreeGpuQueries;
+	bool bGpuScopeOpen = false;
+	void ReadBackGpuQueries(uint64_t const OfFrame);
+	void ReleaseGpuQueries();
+};
+
+class CScopedCpuTimer
+{
+public:
+	CScopedCpuTimer(char const* const Name) : bActive(CProfiler::Get().IsEnabled()) { if (bActive) CProfiler::Get().BeginCpuScope(Name); }
+	~CScopedCpuTimer() { if (bActive) CProfiler::Get().EndCpuScope(); }
+private:
+	bool const bActive;
+};
+
+class CScopedGpuTimer
+{
+public:
+	CScopedGpuTimer(char const* const Name) : bActive(CProfiler::Get().IsEnabled() && CProfiler::Get().AreGpuTimingsEnabled()) { if (bActive) CProfiler::Get().BeginGpuScope(Name); }
+	~CScopedGpuTimer() { if (bActive) CProfiler::Get().EndGpuScope(); }
+private:
+	bool const bActive;
+};
+
+#define PROFILE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_IMPL(a, b)
+#define PROFILE_CPU_SCOPE(Name) CScopedCpuTimer const PROFILE_CONCAT(_profileCpuScope, __LINE__)(Name)
+#define PROFILE_GPU_SCOPE(Name) CScopedGpuTimer const PROFILE_CONCAT(_profileGpuScope, __LINE__)(Name)
\ No newline at end of file
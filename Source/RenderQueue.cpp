@@ -0,0 +1,146 @@
+#include "RenderQueue.h"
+#include "Mesh.h"
+
+u64 CRenderQueue::MakeSortKey(uint8_t const Layer, const CShader* const Shader, GLuint const Texture, GLuint const VAO)
+{
+	// 8 bits of layer, then 16 bits per GL name (names are small integers).
+	u64 const program = Shader ? (Shader->GetProgramID() & 0xFFFF) : 0;
+	return (u64(Layer) << 56) | (program << 40) | (u64(Texture & 0xFFFF) << 24) | (u64(VAO & 0xFFFF) << 8);
+}
+
+CRenderQueue::~CRenderQueue()
+{
+	// The world may outlive the GL context (glfwTerminate).
+	if (FrameBuffer == 0 || !glfwGetCurrentContext()) return;
+	glDeleteBuffers(1, &FrameBuffer);
+	glDeleteBuffers(NumberOfObjectBuffers, ObjectBuffers);
+}
+
+void CRenderQueue::CreateBuffers()
+{
+	glGenBuffers(1, &FrameBuffer);
+	glGenBuffers(NumberOfObjectBuffers, ObjectBuffers);
+
+	GLint alignment = 256;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	size_t const align = size_t(std::max(alignment, 1));
+	ObjectStride = (sizeof(SObjectUniforms) + align - 1) / align * align;
+}
+
+void CRenderQueue::Begin(SRenderFrame const& Frame)
+{
+	this->Frame = Frame;
+	FrameIndex++;
+	Items.clear();
+	Uploads.clear();
+}
+
+void CRenderQueue::Flush()
+{
+	for (std::function<void()> const& upload : Uploads) upload();
+	Uploads.clear();
+
+	Order.resize(Items.size());
+	for (uint32_t k = 0; k < uint32_t(Items.size()); k++) Order[k] = { Items[k].SortKey, k };
+	std::sort(Order.begin(), Order.end());
+
+	if (FrameBuffer == 0) CreateBuffers();
+	Stats = SRenderStats();
+
+	// Frame uniforms, orphaned at each upload.
+	SFrameUniforms frameUniforms;
+	frameUniforms.View = Frame.View;
+	frameUniforms.Proj = Frame.Proj;
+	frameUniforms.CameraPosition = glm::vec4(Frame.CameraPosition, 1.f);
+	frameUniforms.LightPosition = glm::vec4(Frame.LightPosition, 1.f);
+	frameUniforms.LightColor = glm::vec4(Frame.LightColor, 1.f);
+	glBindBuffer(GL_UNIFORM_BUFFER, FrameBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(frameUniforms), &frameUniforms, GL_STREAM_DRAW);
+	glBindBufferBase(GL_UNIFORM_BUFFER, UBB_Frame, FrameBuffer);
+	Stats.UniformBytes += uint32_t(sizeof(frameUniforms));
+
+	// Object uniforms of all the items, in draw order.
+	ObjectData.resize(Order.size() * ObjectStride);
+	for (size_t k = 0; k < Order.size(); k++)
+	{
+		SDrawItem const& item = Items[Order[k].second];
+		SObjectUniforms& objectUniforms = *reinterpret_cast<SObjectUniforms*>(&ObjectData[k * ObjectStride]);
+		objectUniforms.Model = item.Model;
+		objectUniforms.NormalMatrix = glm::mat3x4(item.NormalMatrix);
+		objectUniforms.Material = item.Material;
+		objectUniforms.PositionScale = glm::vec4(item.PositionScale, 0.f);
+		objectUniforms.PositionOffset = glm::vec4(item.PositionOffset, 0.f);
+	}
+	uint32_t const ring = FrameIndex % NumberOfObjectBuffers;
+	GLuint const objectBuffer = ObjectBuffers[ring];
+	glBindBuffer(GL_UNIFORM_BUFFER, objectBuffer);
+	if (ObjectData.size() > ObjectBufferSizes[ring])
+	{
+		ObjectBufferSizes[ring] = ObjectData.size() * 2;
+		glBufferData(GL_UNIFORM_BUFFER, ObjectBufferSizes[ring], nullptr, GL_STREAM_DRAW);
+	}
+	if (!ObjectData.empty()) glBufferSubData(GL_UNIFORM_BUFFER, 0, ObjectData.size(), ObjectData.data());
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	Stats.UniformBytes += uint32_t(ObjectData.size());
+
+	// Nothing is assumed about the state left by the code drawing outside of the queue.
+	ProgramsSetUp.clear();
+	const CShader* boundShader = nullptr;
+	GLuint boundTexture = GLuint(-1), boundVAO = GLuint(-1);
+
+	for (size_t k = 0; k < Order.size(); k++)
+	{
+		SDrawItem const& item = Items[Order[k].second];
+		if (!item.Shader || item.VAO == 0) continue;
+
+		if (item.Shader != boundShader)
+		{
+			item.Shader->Use();
+			boundShader = item.Shader;
+			Stats.ProgramBinds++;
+			if (item.SamplerName && std::find(ProgramsSetUp.begin(), ProgramsSetUp.end(), item.Shader) == ProgramsSetUp.end())
+			{
+				item.Shader->SetUniform(item.SamplerName, 0);
+				ProgramsSetUp.push_back(item.Shader);
+			}
+		}
+		// Texture 0 is bound too: an untextured item (or one whose texture is still streaming) must not sample the previous one's.
+		if (item.Texture != boundTexture)
+		{
+			if (boundTexture == GLuint(-1)) glActiveTexture(GL_TEXTURE0);
+			glBindTexture(GL_TEXTURE_2D, item.Texture);
+			boundTexture = item.Texture;
+			Stats.TextureBinds++;
+		}
+		if (item.VAO != boundVAO)
+		{
+			glBindVertexArray(item.VAO);
+			boundVAO = item.VAO;
+			Stats.VAOBinds++;
+		}
+
+		glBindBufferRange(GL_UNIFORM_BUFFER, UBB_Object, objectBuffer, GLintptr(k * ObjectStride), sizeof(SObjectUniforms));
+
+		// Program + texture + VAO bind and unbind.
+		Stats.ImmediateBinds += (item.Texture != 0 ? 4 : 3);
+		Stats.Draws++;
+		if (item.InstanceCount == 0)
+		{
+			glDrawElements(GL_TRIANGLES, item.IndexCount, item.IndexType, item.IndexOffset);
+			continue;
+		}
+
+		std::pair<GLuint, uint32_t> const instanceBinding(item.InstanceVBO, item.FirstInstance);
+		auto const binding = InstanceBindings.find(item.VAO);
+		if (binding == InstanceBindings.end() || binding->second != instanceBinding)
+		{
+			SetInstanceAttributes(item.InstanceVBO, item.FirstInstance);
+			InstanceBindings[item.VAO] = instanceBinding;
+			Stats.InstanceBufferBinds++;
+		}
+		glDrawElementsInstanced(GL_TRIANGLES, item.IndexCount, item.IndexType, item.IndexOffset, item.InstanceCount);
+	}
+
+	if (boundVAO != GLuint(-1)) glBindVertexArray(0);
+	Items.clear();
+}
\ No newline at end of file
@@ -0,0 +1,121 @@
+#pragma once
+#include "Types.h"
+#include "Shader.h"
+
+// std140 mirror of the FrameUniforms block (vec3 members take 16 bytes).
+struct SFrameUniforms
+{
+	glm::mat4 View;
+	glm::mat4 Proj;
+	glm::vec4 CameraPosition;
+	glm::vec4 LightPosition;
+	glm::vec4 LightColor;
+};
+static_assert(sizeof(SFrameUniforms) == 176, "SFrameUniforms must match the std140 layout of FrameUniforms");
+
+// std140 mirror of the ObjectUniforms block (a mat3 is 3 columns of vec4).
+struct SObjectUniforms
+{
+	glm::mat4	Model;
+	glm::mat3x4	NormalMatrix;
+	glm::mat4	Material;
+	glm::vec4	PositionScale;
+	glm::vec4	PositionOffset;
+};
+static_assert(sizeof(SObjectUniforms) == 208, "SObjectUniforms must match the std140 layout of ObjectUniforms");
+
+// One glDrawElements(Instanced) with everything it needs bound.
+struct SDrawItem
+{
+	u64				SortKey = 0;		// Cf. CRenderQueue::MakeSortKey.
+	const CShader*	Shader = nullptr;
+	GLuint			Texture = 0;		// On unit 0, 0 = none.
+	const char*		SamplerName = nullptr;
+	GLuint			VAO = 0;
+	GLenum			IndexType = GL_UNSIGNED_INT;
+	GLsizei			IndexCount = 0;
+	const GLvoid*	IndexOffset = nullptr;
+	// Instanced draws (InstanceCount > 0) read SInstanceData from InstanceVBO, starting at FirstInstance.
+	GLsizei			InstanceCount = 0;
+	GLuint			InstanceVBO = 0;
+	uint32_t		FirstInstance = 0;
+
+	// ObjectUniforms. Model and NormalMatrix are ignored by the instanced draws.
+	glm::mat4		Model;
+	glm::mat3		NormalMatrix;
+	glm::mat4		Material;
+	glm::vec3		PositionScale;
+	glm::vec3		PositionOffset;
+};
+
+// Uniforms shared by all the draws of a frame.
+struct SRenderFrame
+{
+	glm::mat4 View;
+	glm::mat4 Proj;
+	glm::vec3 CameraPosition;
+	glm::vec3 LightPosition;
+	glm::vec3 LightColor;
+};
+
+// GL state changes issued by the last Flush.
+struct SRenderStats
+{
+	uint32_t Draws = 0;
+	uint32_t ProgramBinds = 0;
+	uint32_t TextureBinds = 0;
+	uint32_t VAOBinds = 0;
+	uint32_t InstanceBufferBinds = 0;	// Instance attributes re-pointed (cf. SetInstanceAttributes).
+	uint32_t ImmediateBinds = 0;		// What binding everything for each draw would have cost.
+	uint32_t UniformBytes = 0;			// Uploaded to the frame and object uniform buffers.
+
+	uint32_t GetStateChanges() const { return ProgramBinds + TextureBinds + VAOBinds + InstanceBufferBinds; }
+};
+
+// Draw items are submitted during the frame, then sorted by key and issued with only the state changes
+// between consecutive items (GL thread only).
+// The frame uniforms are uploaded and bound once per Flush. The object uniforms of all the items are
+// uploaded at once to a ring of buffers, each draw only binds its range.
+class CRenderQueue
+{
+public:
+	~CRenderQueue();
+
+	// Program first (the most expensive switch), then texture, then VAO. Layer orders groups of items
+	// that have to be drawn in sequence (0 for the opaque geometry).
+	static u64 MakeSortKey(uint8_t const Layer, const CShader* const Shader, GLuint const Texture, GLuint const VAO);
+
+	void Begin(SRenderFrame const& Frame);
+	void Submit(SDrawItem const& Item) { Items.push_back(Item); }
+	// Run at the start of Flush, before any item is issued (instance buffers filled during the submission...).
+	void AddUpload(std::function<void()>&& Upload) { Uploads.push_back(std::move(Upload)); }
+	void Flush();
+
+	// Incremented by Begin, to tell submissions of different frames apart.
+	uint32_t GetFrameIndex() const { return FrameIndex; }
+	SRenderStats const& GetStats() const { return Stats; }
+
+private:
+	SRenderFrame Frame;
+	uint32_t FrameIndex = 0;
+	vector<SDrawItem> Items;
+	vector<std::pair<u64, uint32_t>> Order; // (key, item index), sorted.
+	vector<std::function<void()>> Uploads;
+	SRenderStats Stats;
+
+	// The buffer written by a frame is not touched again before NumberOfObjectBuffers frames, so that
+	// the upload doesn't wait for the draws of the previous frames.
+	static constexpr uint32_t NumberOfObjectBuffers = 3;
+	GLuint FrameBuffer = 0;
+	GLuint ObjectBuffers[NumberOfObjectBuffers] = {};
+	size_t ObjectBufferSizes[NumberOfObjectBuffers] = {};
+	size_t ObjectStride = 0;	// sizeof(SObjectUniforms) rounded up to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT.
+	vector<uint8_t> ObjectData;
+
+	void CreateBuffers();
+
+	// Programs whose sampler has been set during this Flush.
+	vector<const CShader*> ProgramsSetUp;
+	// Instance buffer and first instance the instance attributes of each VAO point to.
+	unordered_map<GLuint, std::pair<GLuint, uint32_t>> InstanceBindings;
+};
\ No newline at end of file
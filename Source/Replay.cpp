@@ -0,0 +1,180 @@
+#include "Replay.h"
+#include "FileUtil.h"
+#include "World.h"
+
+CReplayWriter::CReplayWriter(string const& Path, uint64_t const Seed, SPhysicsSettings const& PhysicsSettings) : Path(Path)
+{
+	Buffer.reserve(1 << 16);
+	Buffer.insert(Buffer.end(), Replay::Magic, Replay::Magic + sizeof(Replay::Magic));
+	Write(Replay::Version);
+	Write(Seed);
+	// Only what changes the simulation (not Threading: a recording is always stepped inline).
+	Write(uint8_t(PhysicsSettings.AsteroidSelfCollisions));
+	Write(uint8_t(PhysicsSettings.SleepingEnabled));
+	Write(PhysicsSettings.SleepLinearVelocity);
+	Write(PhysicsSettings.SleepAngularVelocity);
+	Write(PhysicsSettings.TimeBeforeSleep);
+	// They decide how many steps each recorded Dt is. No wall-clock budget while recording.
+	assert(PhysicsSettings.Substeps.StepBudget == 0.f);
+	Write(PhysicsSettings.Substeps.MaxSubstepsPerFrame);
+	Write(uint8_t(PhysicsSettings.Substeps.TimeDilation));
+	Write(PhysicsSettings.Substeps.MinTimeScale);
+	Write(PhysicsSettings.Substeps.TimeScaleRecovery);
+}
+
+void CReplayWriter::WriteFrame(float const Dt)
+{
+	Write(Replay::ERecord::Frame);
+	Write(Dt);
+	FramesSinceStateHash++;
+}
+
+void CReplayWriter::WriteKey(int const Key, int const Scancode, int const Action, int const Mods)
+{
+	Write(Replay::ERecord::Key);
+	Write(int32_t(Key));
+	Write(int32_t(Scancode));
+	Write(uint8_t(Action));
+	Write(uint8_t(Mods));
+}
+
+void CReplayWriter::WriteStateHash(uint64_t const Hash)
+{
+	Write(Replay::ERecord::StateHash);
+	Write(Hash);
+	FramesSinceStateHash = 0;
+}
+
+bool CReplayWriter::Close()
+{
+	if (bClosed) return true;
+	bClosed = true;
+	if (!saveFile(Path, Buffer)) { ConsoleWriteErr("CReplayWriter::Close : can't write %s", Path.c_str()); return false; }
+	ConsoleWriteOk("Replay: %u bytes written to %s", uint32_t(Buffer.size()), Path.c_str());
+	return true;
+}
+
+// Sequential reads from the loaded file.
+class CReplayReader
+{
+public:
+	CReplayReader(vector<uint8_t> const& Buffer) : Buffer(Buffer) {}
+
+	bool IsAtEnd() const { return Offset >= Buffer.size(); }
+	template<typename T> bool Read(T& ValueOut)
+	{
+		if (Offset + sizeof(T) > Buffer.size()) return false;
+		std::memcpy(&ValueOut, &Buffer[Offset], sizeof(T));
+		Offset += sizeof(T);
+		return true;
+	}
+
+private:
+	vector<uint8_t> const& Buffer;
+	size_t Offset = 0;
+};
+
+// Cf. CReplayWriter::CReplayWriter. The other settings are left as they are.
+static bool ReadPhysicsSettings(CReplayReader& Reader, SPhysicsSettings& SettingsOut)
+{
+	uint8_t asteroidSelfCollisions = 0, sleepingEnabled = 0;
+	if (!Reader.Read(asteroidSelfCollisions) || !Reader.Read(sleepingEnabled)) return false;
+	if (!Reader.Read(SettingsOut.SleepLinearVelocity) || !Reader.Read(SettingsOut.SleepAngularVelocity) || !Reader.Read(SettingsOut.TimeBeforeSleep)) return false;
+	SettingsOut.AsteroidSelfCollisions = asteroidSelfCollisions != 0;
+	SettingsOut.SleepingEnabled = sleepingEnabled != 0;
+
+	SSubstepSettings& substeps = SettingsOut.Substeps;
+	uint8_t timeDilation = 0;
+	if (!Reader.Read(substeps.MaxSubstepsPerFrame) || !Reader.Read(timeDilation)) return false;
+	if (!Reader.Read(substeps.MinTimeScale) || !Reader.Read(substeps.TimeScaleRecovery)) return false;
+	substeps.TimeDilation = timeDilation != 0;
+	substeps.StepBudget = 0.f;
+	return true;
+}
+
+int RunReplay(string const& Path)
+{
+	vector<uint8_t> buffer;
+	if (!loadFile(Path, buffer)) { ConsoleWriteErr("RunReplay : can't read %s", Path.c_str()); return -1; }
+
+	CReplayReader reader(buffer);
+	char magic[sizeof(Replay::Magic)]; uint32_t version = 0; uint64_t seed = 0;
+	if (!reader.Read(magic) || std::memcmp(magic, Replay::Magic, sizeof(magic)) != 0 || !reader.Read(version) || !reader.Read(seed))
+	{
+		ConsoleWriteErr("RunReplay : %s is not a replay file", Path.c_str());
+		return -1;
+	}
+	if (version != Replay::Version)
+	{
+		ConsoleWriteErr("RunReplay : %s has version %u, expected %u (recorded by another build, it would not simulate the same game)",
+			Path.c_str(), version, Replay::Version);
+		return -1;
+	}
+	// The command line ones are overridden: the world has to be simulated as it was recorded.
+	SPhysicsSettings physicsSettings = CWorld::GetPhysicsSettings();
+	if (!ReadPhysicsSettings(reader, physicsSettings)) { ConsoleWriteErr("RunReplay : %s is truncated or corrupted", Path.c_str()); return -1; }
+	physicsSettings.Threading = EPhysicsThreading::Inline;
+	CWorld::SetPhysicsSettings(physicsSettings);
+
+	// Has to be set before the world spawns its first asteroids.
+	CRandomizer::SetGlobalSeed(seed);
+	CWorld World(nullptr);
+
+	ConsoleWriteOk("Replaying %s (seed %llu, asteroid collisions %s, sleeping %s, %u substeps per frame at most, time dilation %s)...",
+		Path.c_str(), (unsigned long long)seed, physicsSettings.AsteroidSelfCollisions ? "on" : "off", physicsSettings.SleepingEnabled ? "on" : "off",
+		physicsSettings.Substeps.MaxSubstepsPerFrame, physicsSettings.Substeps.TimeDilation ? "on" : "off");
+	uint32_t numberOfFrames = 0, numberOfHashes = 0, numberOfMismatches = 0;
+	using clock = std::chrono::steady_clock;
+	clock::time_point const startTime = clock::now();
+	while (!reader.IsAtEnd())
+	{
+		Replay::ERecord type;
+		reader.Read(type);
+		bool ok = true;
+		switch (type)
+		{
+		case Replay::ERecord::Frame:
+		{
+			float Dt = 0.f;
+			ok = reader.Read(Dt);
+			if (!ok) break;
+			CProfiler::Get().BeginFrame();
+			World.Update(Dt);
+			CProfiler::Get().EndFrame();
+			numberOfFrames++;
+			break;
+		}
+		case Replay::ERecord::Key:
+		{
+			int32_t key = 0, scancode = 0; uint8_t action = 0, mods = 0;
+			ok = reader.Read(key) && reader.Read(scancode) && reader.Read(action) && reader.Read(mods);
+			if (ok) World.HandleKeyboardInputs(key, scancode, action, mods);
+			break;
+		}
+		case Replay::ERecord::StateHash:
+		{
+			uint64_t hash = 0;
+			ok = reader.Read(hash);
+			if (!ok) break;
+			numberOfHashes++;
+			uint64_t const replayedHash = World.ComputeStateHash();
+			if (replayedHash != hash)
+			{
+				if (numberOfMismatches == 0) ConsoleWriteErr("RunReplay : state diverged at frame %u (recorded %016llx, replayed %016llx)",
+					numberOfFrames, (unsigned long long)hash, (unsigned long long)replayedHash);
+				numberOfMismatches++;
+			}
+			break;
+		}
+		default:
+			ok = false;
+		}
+		if (!ok) { ConsoleWriteErr("RunReplay : %s is truncated or corrupted", Path.c_str()); return -1; }
+	}
+	double const elapsed = std::chrono::duration<double>(clock::now() - startTime).count();
+
+	ConsoleWrite(" -> %u frames in %.3f s, %.1f frames/s (%.3f ms/frame)", numberOfFrames, elapsed, numberOfFrames / elapsed, 1000. * elapsed / std::max(1u, numberOfFrames));
+	ConsoleWrite(" -> %u/%u state hashes matching, final state hash %016llx",
+		numberOfHashes - numberOfMismatches, numberOfHashes, (unsigned long long)World.ComputeStateHash());
+	return numberOfMismatches == 0 ? 0 : 1;
+}
\ No newline at end of file
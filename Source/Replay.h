@@ -0,0 +1,57 @@
+#pragma once
+#include "Types.h"
+
+// Record/replay of a game session. With the same global seed (cf. CRandomizer), the same per-frame Dt
+// and the same keyboard events in the same order, CWorld simulates the exact same game.
+//
+// Binary stream: header (magic, version, seed, physics settings) then records, each one a type byte followed by its payload:
+// - Frame: float Dt, precedes the CWorld::Update it is passed to.
+// - Key: int32 Key, int32 Scancode, uint8 Action, uint8 Mods, in the order of the CWorld::HandleKeyboardInputs calls.
+// - StateHash: uint64 CWorld::ComputeStateHash after the last Update, written every StateHashPeriod frames.
+namespace Replay
+{
+	static constexpr char Magic[4] = { 'S', 'F', 'R', 'P' };
+	// Bumped whenever the format or the simulation of a recording changes: the older files are rejected.
+	// 2: interpolation between the last two physics states (CPhysicsThread).
+	// 3: physics settings in the header.
+	// 4: substep settings in the header, at most 4 substeps per frame by default.
+	static constexpr uint32_t Version = 4;
+	static constexpr uint32_t StateHashPeriod = 60;
+
+	enum class ERecord : uint8_t { Frame, Key, StateHash };
+}
+
+struct SPhysicsSettings;
+
+class CReplayWriter
+{
+public:
+	// The records are buffered in memory and written to Path by Close (or the destructor).
+	// The physics settings changing the simulation are recorded, RunReplay plays them back.
+	CReplayWriter(string const& Path, uint64_t const Seed, SPhysicsSettings const& PhysicsSettings);
+	~CReplayWriter() { Close(); }
+
+	void WriteFrame(float const Dt);
+	void WriteKey(int const Key, int const Scancode, int const Action, int const Mods);
+	// True once every StateHashPeriod frames.
+	bool IsStateHashDue() const { return FramesSinceStateHash >= Replay::StateHashPeriod; }
+	void WriteStateHash(uint64_t const Hash);
+
+	bool Close();
+
+private:
+	string const Path;
+	vector<uint8_t> Buffer;
+	uint32_t FramesSinceStateHash = 0;
+	bool bClosed = false;
+
+	template<typename T> void Write(T const& Value)
+	{
+		uint8_t const* const bytes = reinterpret_cast<uint8_t const*>(&Value);
+		Buffer.insert(Buffer.end(), bytes, bytes + sizeof(T));
+	}
+};
+
+// Re-simulates a recording headless, as fast as possible, with its physics settings, and checks the state hashes.
+// Returns the process exit code (non-zero if the file is invalid or the simulation diverged).
+int RunReplay(string const& Path);
\ No newline at end of file
@@ -2,11 +2,63 @@
 #include "FileUtil.h"
 #include "StringUtil.h"
 
+uint32_t CShader::s_lookupsAvoided = 0;
+uint32_t CShader::s_lookupsAvoidedLastFrame = 0;
+bool CShader::s_binaryCacheEnabled = true;
+string CShader::s_binaryCacheDirectory = ROOT_DIR"Cache\\Programs";
+uint32_t CShader::s_numCompiled = 0;
+uint32_t CShader::s_numFromBinary = 0;
+
+// Header of the .programcache files, followed by the binary.
+struct SProgramCacheHeader
+{
+	char		Magic[4];
+	uint32_t	Version;
+	u64			Key;		// Sources and driver, cf. CShader::Load.
+	uint32_t	Format;		// GLenum given by glGetProgramBinary.
+	uint32_t	Length;
+};
+static constexpr char gProgramCacheMagic[4] = { 'S', 'F', 'P', 'B' };
+static constexpr uint32_t gProgramCacheVersion = 1;
+
+static bool IsProgramBinarySupported()
+{
+	if (!(GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary)) return false;
+	GLint numberOfFormats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numberOfFormats);
+	return numberOfFormats > 0;
+}
+
+static void HashString(u64& hash, const string& str)
+{
+	for (char const c : str) { hash ^= uint8_t(c); hash *= 1099511628211ull; }
+	hash ^= 0xFF; hash *= 1099511628211ull; // Separator.
+}
+
+// Programs sharing a vertex shader differ by their fragment shader: both paths are hashed (FNV-1a 64) into the cache name.
+string CShader::GetBinaryCachePath(const string& vertexPath, const string& fragmentPath)
+{
+	string const vertex = stringReplaceAllTokens(getCanonicalPath(vertexPath), "\\", "/");
+	string const fragment = stringReplaceAllTokens(getCanonicalPath(fragmentPath), "\\", "/");
+	u64 hash = 14695981039346656037ull;
+	HashString(hash, vertex);
+	HashString(hash, fragment);
+	char prefix[32];
+	snprintf(prefix, sizeof(prefix), "%016llx_", (unsigned long long)hash);
+	return stringReplaceAllTokens(s_binaryCacheDirectory, "\\", "/") + '/' + prefix + vertex.substr(vertex.find_last_of('/') + 1) + ".programcache";
+}
+
 CShader::CShader()
 {
 	m_programID = (GLuint)-1;
 }
 
+void CShader::NewFrame()
+{
+	s_lookupsAvoidedLastFrame = s_lookupsAvoided;
+	s_lookupsAvoided = 0;
+}
+
 bool CShader::Load(const string& vertexPath, const string& fragmentPath)
 {
 	string vertexCode;
@@ -23,6 +75,27 @@ bool CShader::Load(const string& vertexPath, const string& fragmentPath)
 		return false;
 	}
 
+	// The binaries are only valid for the same sources on the same driver.
+	string const cachePath = GetBinaryCachePath(vertexPath, fragmentPath);
+	static bool const binarySupported = IsProgramBinarySupported();
+	bool const useBinaryCache = s_binaryCacheEnabled && binarySupported;
+	u64 key = 14695981039346656037ull;
+	if (useBinaryCache)
+	{
+		HashString(key, vertexCode);
+		HashString(key, fragmentCode);
+		HashString(key, (const char*)glGetString(GL_VENDOR));
+		HashString(key, (const char*)glGetString(GL_RENDERER));
+		HashString(key, (const char*)glGetString(GL_VERSION));
+		if (LoadBinary(cachePath, key))
+		{
+			ReflectUniforms();
+			BindUniformBlocks();
+			s_numFromBinary++;
+			return true;
+		}
+	}
+
 	const char*	vertexShaderSource   = vertexCode  .c_str();
 	const char*	fragmentShaderSource = fragmentCode.c_str();
 	GLint		success;
@@ -58,15 +131,130 @@ bool CShader::Load(const string& vertexPath, const string& fragmentPath)
 	m_programID = glCreateProgram();
 	glAttachShader(m_programID, vertexShaderID);
 	glAttachShader(m_programID, fragmentShaderID);
+	if (useBinaryCache) glProgramParameteri(m_programID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 	glLinkProgram(m_programID);
 
 	// Delete shaders
 	glDeleteShader(vertexShaderID);
 	glDeleteShader(fragmentShaderID);
 
+	glGetProgramiv(m_programID, GL_LINK_STATUS, &success);
+	if (!success)
+	{
+		glGetProgramInfoLog(m_programID, 512, NULL, infoLog);
+		ConsoleWriteErr("CShader::CShader() : link failed for %s\n%s", vertexPath.c_str(), infoLog);
+		glDeleteProgram(m_programID);
+		m_programID = (GLuint)-1;
+		return false;
+	}
+
+	ReflectUniforms();
+	BindUniformBlocks();
+	s_numCompiled++;
+	if (useBinaryCache) SaveBinary(cachePath, key);
+
 	return true;
 }
 
+bool CShader::LoadBinary(const string& cachePath, u64 key)
+{
+	vector<uint8_t> buffer;
+	if (!isFileExist(cachePath) || !loadFile(cachePath, buffer)) return false;
+
+	SProgramCacheHeader header;
+	if (buffer.size() < sizeof(header)) return false;
+	memcpy(&header, buffer.data(), sizeof(header));
+	if (memcmp(header.Magic, gProgramCacheMagic, sizeof(gProgramCacheMagic)) != 0 || header.Version != gProgramCacheVersion ||
+		header.Key != key || buffer.size() != sizeof(header) + header.Length)
+	{
+		return false;
+	}
+
+	// The driver may still refuse it (after an update with the same version string...): compiling then.
+	GLuint const programID = glCreateProgram();
+	glProgramBinary(programID, header.Format, buffer.data() + sizeof(header), (GLsizei)header.Length);
+	GLint success = GL_FALSE;
+	glGetProgramiv(programID, GL_LINK_STATUS, &success);
+	if (!success)
+	{
+		glDeleteProgram(programID);
+		return false;
+	}
+	m_programID = programID;
+	return true;
+}
+
+void CShader::SaveBinary(const string& cachePath, u64 key) const
+{
+	GLint length = 0;
+	glGetProgramiv(m_programID, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0) return;
+
+	SProgramCacheHeader header;
+	memcpy(header.Magic, gProgramCacheMagic, sizeof(gProgramCacheMagic));
+	header.Version = gProgramCacheVersion;
+	header.Key = key;
+	header.Length = uint32_t(length);
+
+	vector<uint8_t> buffer(sizeof(header) + size_t(length));
+	GLenum format = 0;
+	GLsizei written = 0;
+	glGetProgramBinary(m_programID, length, &written, &format, buffer.data() + sizeof(header));
+	if (written != length) return;
+	header.Format = uint32_t(format);
+	memcpy(buffer.data(), &header, sizeof(header));
+	if (!createDirectories(cachePath.substr(0, cachePath.find_last_of('/'))))
+	{
+		ConsoleWriteErr("CShader::SaveBinary : can't create the directory of %s", cachePath.c_str());
+		return;
+	}
+	if (!saveFile(cachePath, buffer)) ConsoleWriteErr("CShader::SaveBinary : can't write %s", cachePath.c_str());
+}
+
+void CShader::ReflectUniforms()
+{
+	m_uniformLocations.clear();
+	m_collidingUniformLocations.clear();
+	// Names of the uniforms per hash, to move both to the string-keyed map on a collision.
+	unordered_map<uint32_t, string> names;
+
+	GLint	uniformCount = 0;
+	GLchar	name[256];
+	glGetProgramiv(m_programID, GL_ACTIVE_UNIFORMS, &uniformCount);
+	for (GLint i = 0; i < uniformCount; i++)
+	{
+		GLsizei	length = 0;
+		GLint	size;
+		GLenum	type;
+		glGetActiveUniform(m_programID, (GLuint)i, sizeof(name), &length, &size, &type, name);
+
+		// Arrays are reported as "name[0]", we want them under "name".
+		if (length > 3 && strcmp(name + length - 3, "[0]") == 0) name[length - 3] = '\0';
+
+		GLint const location = glGetUniformLocation(m_programID, name);
+		if (location == -1) continue; // Uniform blocks members...
+
+		uint32_t const hash = HashUniformName(name);
+		auto const iter = m_uniformLocations.find(hash);
+		if (iter == m_uniformLocations.end()) { m_uniformLocations[hash] = location; names[hash] = name; continue; }
+
+		// Hash collision: slower, but still the right location.
+		ConsoleWriteWarn("CShader::ReflectUniforms : %s and %s have the same hash, looked up by name", names[hash].c_str(), name);
+		if (iter->second != CollidingHash) m_collidingUniformLocations[names[hash]] = iter->second;
+		iter->second = CollidingHash;
+		m_collidingUniformLocations[name] = location;
+	}
+}
+
+void CShader::BindUniformBlocks() const
+{
+	// Programs that don't declare a block just don't get it.
+	GLuint const frameBlock = glGetUniformBlockIndex(m_programID, "FrameUniforms");
+	if (frameBlock != GL_INVALID_INDEX) glUniformBlockBinding(m_programID, frameBlock, UBB_Frame);
+	GLuint const objectBlock = glGetUniformBlockIndex(m_programID, "ObjectUniforms");
+	if (objectBlock != GL_INVALID_INDEX) glUniformBlockBinding(m_programID, objectBlock, UBB_Object);
+}
+
 CShader::~CShader()
 {
 	if (m_programID != (GLuint)-1)
@@ -83,65 +271,107 @@ void CShader::Use() const
 	}
 }
 
-GLint CShader::GetUniformLocation(const string& name) const
+GLint CShader::GetUniformLocation(const char* name) const
 {
 	GLint res = -1;
 	if (m_programID != (GLuint)-1)
 	{
-		res = glGetUniformLocation(m_programID, name.c_str());
-		if (res == -1)
+		auto const iter = m_uniformLocations.find(HashUniformName(name));
+		if (iter == m_uniformLocations.end())
 		{
-			ConsoleWriteErr("CShader::GetUniformLocation(%s) : No such uniform", name.c_str());
+			ConsoleWriteErr("CShader::GetUniformLocation(%s) : No such uniform", name);
 			return -1;
 		}
+		res = iter->second;
+		if (res == CollidingHash)
+		{
+			auto const nameIter = m_collidingUniformLocations.find(name);
+			if (nameIter == m_collidingUniformLocations.end())
+			{
+				ConsoleWriteErr("CShader::GetUniformLocation(%s) : No such uniform", name);
+				return -1;
+			}
+			res = nameIter->second;
+		}
+		s_lookupsAvoided++;
 	}
 	return res;
 }
 
-void CShader::SetUniform(const string& name, const glm::mat4& mat) const
+void CShader::SetUniform(const char* name, const glm::mat4& mat) const
 {
 	GLint loc = GetUniformLocation(name);
 	glUniformMatrix4fv(loc, 1, GL_FALSE, glm::value_ptr(mat));
 }
 
-void CShader::SetUniform(const string& name, const glm::mat3& mat) const
+void CShader::SetUniform(const char* name, const glm::mat3& mat) const
 {
 	GLint loc = GetUniformLocation(name);
 	glUniformMatrix3fv(loc, 1, GL_FALSE, glm::value_ptr(mat));
 }
 
-void CShader::SetUniform(const string& name, const glm::vec3& vec) const
+void CShader::SetUniform(const char* name, const glm::vec3& vec) const
 {
 	GLint loc = GetUniformLocation(name);
 	glUniform3f(loc, vec.x, vec.y, vec.z);
 }
 
-void CShader::SetUniform(const string& name, const glm::vec4& vec) const
+void CShader::SetUniform(const char* name, const glm::vec4& vec) const
 {
 	GLint loc = GetUniformLocation(name);
 	glUniform4f(loc, vec.x, vec.y, vec.z, vec.w);
 }
 
-void CShader::SetUniform(const string& name, GLfloat x, GLfloat y, GLfloat z, GLfloat w) const
+void CShader::SetUniform(const char* name, GLfloat x, GLfloat y, GLfloat z, GLfloat w) const
 {
 	GLint loc = GetUniformLocation(name);
 	glUniform4f(loc, x, y, z, w);
 }
 
-void CShader::SetUniform(const string& name, GLfloat x, GLfloat y, GLfloat z) const
+void CShader::SetUniform(const char* name, GLfloat x, GLfloat y, GLfloat z) const
 {
 	GLint loc = GetUniformLocation(name);
 	glUniform3f(loc, x, y, z);
 }
 
-void CShader::SetUniform(const string& name, GLfloat x) const
+void CShader::SetUniform(const char* name, GLfloat x) const
 {
 	GLint loc = GetUniformLocation(name);
 	glUniform1f(loc, x);
 }
 
-void CShader::SetUniform(const string& name, int x) const
+void CShader::SetUniform(const char* name, int x) const
 {
 	GLint loc = GetUniformLocation(name);
 	glUniform1i(loc, x);
 }
+
+CShaderLibrary& CShaderLibrary::Get()
+{
+	static CShaderLibrary library;
+	return library;
+}
+
+std::shared_ptr<CShader> CShaderLibrary::Acquire(const string& vertexPath, const string& fragmentPath)
+{
+	string const key = vertexPath + '|' + fragmentPath;
+	std::shared_ptr<CShader> shader = m_programs[key].lock();
+	if (shader)
+	{
+		m_numHits++;
+		return shader;
+	}
+
+	std::chrono::steady_clock::time_point const startTime = std::chrono::steady_clock::now();
+	shader = std::make_shared<CShader>();
+	bool const loaded = shader->Load(vertexPath, fragmentPath);
+	m_buildTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+	m_numBuilds++;
+	if (!loaded)
+	{
+		m_programs.erase(key);
+		return nullptr;
+	}
+	m_programs[key] = shader;
+	return shader;
+}
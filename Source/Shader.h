@@ -1,27 +1,98 @@
 #pragma once
 #include "Types.h"
 
+// Binding points of the uniform blocks shared by the shaders of Resources/Shaders (cf. CRenderQueue).
+enum EUniformBlockBinding : GLuint
+{
+	UBB_Frame	= 0,	// FrameUniforms: view, proj, camera and light.
+	UBB_Object	= 1		// ObjectUniforms: model and normal matrices, material, position decoding.
+};
+
 class CShader
 {
 	private:
 		GLuint m_programID;
 
+		// Active uniforms of the program, reflected once at link time (name hash -> location).
+		unordered_map<uint32_t, GLint> m_uniformLocations;
+		// Uniforms whose names hash the same are looked up by name instead (their hash maps to CollidingHash).
+		static constexpr GLint CollidingHash = -2;
+		unordered_map<string, GLint> m_collidingUniformLocations;
+
+		// Number of glGetUniformLocation calls saved by the cache, for the current and the last frame.
+		static uint32_t s_lookupsAvoided;
+		static uint32_t s_lookupsAvoidedLastFrame;
+
+		// On-disk cache of the linked programs (glGetProgramBinary), in a cache directory out of Resources.
+		static bool s_binaryCacheEnabled;
+		static string s_binaryCacheDirectory;
+		static uint32_t s_numCompiled;
+		static uint32_t s_numFromBinary;
+
+		void	ReflectUniforms();
+		void	BindUniformBlocks() const;	// GLSL 3.30 has no layout(binding), cf. EUniformBlockBinding.
+		static string	GetBinaryCachePath(const string& vertexPath, const string& fragmentPath);
+		bool	LoadBinary(const string& cachePath, u64 key);
+		void	SaveBinary(const string& cachePath, u64 key) const;
+
 	public:
 
 		CShader();
 		~CShader();
+		CShader(const CShader&) = delete;
+		CShader& operator=(const CShader&) = delete;
+
+		// FNV-1a, used to key the uniform cache without building any std::string.
+		static constexpr uint32_t HashUniformName(const char* name)
+		{
+			uint32_t hash = 2166136261u;
+			while (*name) hash = (hash ^ uint32_t(uint8_t(*name++))) * 16777619u;
+			return hash;
+		}
+
+		// Call once per frame: the counter of the frame that just ended becomes available through GetLookupsAvoidedLastFrame.
+		static void		NewFrame();
+		static uint32_t	GetLookupsAvoidedLastFrame() { return s_lookupsAvoidedLastFrame; }
+
+		// The program binaries are only used if the driver supports them (GL 4.1 or ARB_get_program_binary).
+		static void		SetBinaryCacheEnabled(bool enabled) { s_binaryCacheEnabled = enabled; }
+		static void		SetBinaryCacheDirectory(const string& directory) { s_binaryCacheDirectory = directory; }
+		// Programs built from GLSL and from the binary cache since the start.
+		static uint32_t	GetNumberOfCompiledPrograms() { return s_numCompiled; }
+		static uint32_t	GetNumberOfBinaryPrograms() { return s_numFromBinary; }
 
 		// use the program
 		bool	Load(const string& vertexPath, const string& fragmentPath);
-		GLint	GetUniformLocation(const string& name) const;
+		GLint	GetUniformLocation(const char* name) const;	// Cached, no driver lookup once loaded.
+		GLuint	GetProgramID() const { return m_programID; }
 		void	Use() const;
 
-		void SetUniform(const string& name, const glm::mat4& mat) const;
-		void SetUniform(const string& name, const glm::mat3& mat) const;
-		void SetUniform(const string& name, const glm::vec4& vec) const;
-		void SetUniform(const string& name, const glm::vec3& vec) const;
-		void SetUniform(const string& name, GLfloat x, GLfloat y, GLfloat z, GLfloat w) const;
-		void SetUniform(const string& name, GLfloat x, GLfloat y, GLfloat z) const;
-		void SetUniform(const string& name, GLfloat x) const;
-		void SetUniform(const string& name, int x) const;
+		void SetUniform(const char* name, const glm::mat4& mat) const;
+		void SetUniform(const char* name, const glm::mat3& mat) const;
+		void SetUniform(const char* name, const glm::vec4& vec) const;
+		void SetUniform(const char* name, const glm::vec3& vec) const;
+		void SetUniform(const char* name, GLfloat x, GLfloat y, GLfloat z, GLfloat w) const;
+		void SetUniform(const char* name, GLfloat x, GLfloat y, GLfloat z) const;
+		void SetUniform(const char* name, GLfloat x) const;
+		void SetUniform(const char* name, int x) const;
+};
+
+// Programs shared by all the models: each vertex/fragment pair is built once, as long as someone holds it.
+class CShaderLibrary
+{
+	public:
+		static CShaderLibrary& Get();
+
+		// GL thread. nullptr if the program can't be built.
+		std::shared_ptr<CShader> Acquire(const string& vertexPath, const string& fragmentPath);
+
+		uint32_t	GetNumberOfBuilds() const { return m_numBuilds; }
+		uint32_t	GetNumberOfHits() const { return m_numHits; }	// Acquisitions that did not build anything.
+		double		GetBuildTime() const { return m_buildTime; }	// In ms, for all the builds.
+
+	private:
+		map<string, std::weak_ptr<CShader>> m_programs; // By "vertexPath|fragmentPath".
+		uint32_t	m_numBuilds = 0;
+		uint32_t	m_numHits = 0;
+		double		m_buildTime = 0.;
 };
\ No newline at end of file
@@ -0,0 +1,168 @@
+#include "SpatialHashGrid.h"
+
+CSpatialHashGrid::CSpatialHashGrid(float const CellSize) : CellSize(CellSize), InverseCellSize(1.f / CellSize)
+{
+	assert(CellSize > 0.f);
+}
+
+uint64_t CSpatialHashGrid::GetCellKey(int32_t const x, int32_t const y, int32_t const z)
+{
+	// 21 bits per coordinate.
+	return (uint64_t(uint32_t(x) & 0x1FFFFF) << 42) | (uint64_t(uint32_t(y) & 0x1FFFFF) << 21) | uint64_t(uint32_t(z) & 0x1FFFFF);
+}
+
+vector<uint32_t> const* CSpatialHashGrid::GetCell(int32_t const x, int32_t const y, int32_t const z) const
+{
+	auto const iter = Cells.find(GetCellKey(x, y, z));
+	return iter == Cells.end() ? nullptr : &iter->second;
+}
+
+void CSpatialHashGrid::Update(uint32_t const Id, glm::vec3 const& Position, float const Radius)
+{
+	if (Id >= Items.size()) Items.resize(Id + 1);
+	SItem& item = Items[Id];
+	item.Position = Position;
+	item.Radius = Radius;
+	MaxRadius = std::max(MaxRadius, Radius);
+
+	uint64_t const cellKey = GetCellKey(GetCellCoordinate(Position.x), GetCellCoordinate(Position.y), GetCellCoordinate(Position.z));
+	if (item.InGrid && item.CellKey == cellKey) return; // Same cell: nothing else to do.
+
+	if (item.InGrid) RemoveFromCell(item, Id);
+	else NumberOfItems++;
+
+	vector<uint32_t>& cell = Cells[cellKey];
+	item.CellKey = cellKey;
+	item.IndexInCell = uint32_t(cell.size());
+	item.InGrid = true;
+	cell.push_back(Id);
+}
+
+void CSpatialHashGrid::Remove(uint32_t const Id)
+{
+	if (!Contains(Id)) return;
+	RemoveFromCell(Items[Id], Id);
+	Items[Id].InGrid = false;
+	NumberOfItems--;
+}
+
+void CSpatialHashGrid::Clear()
+{
+	Items.clear();
+	Cells.clear();
+	NumberOfItems = 0;
+	MaxRadius = 0.f;
+}
+
+void CSpatialHashGrid::RemoveFromCell(SItem& Item, uint32_t const Id)
+{
+	// Swap-and-pop within the cell.
+	auto const iter = Cells.find(Item.CellKey);
+	assert(iter != Cells.end());
+	vector<uint32_t>& cell = iter->second;
+	assert(cell[Item.IndexInCell] == Id);
+
+	uint32_t const lastId = cell.back();
+	cell[Item.IndexInCell] = lastId;
+	Items[lastId].IndexInCell = Item.IndexInCell;
+	cell.pop_back();
+
+	if (cell.empty()) Cells.erase(iter);
+}
+
+void CSpatialHashGrid::QueryRadius(glm::vec3 const& Center, float const Radius, vector<uint32_t>& IdsOut) const
+{
+	VisitRadius(Center, Radius, [&IdsOut](uint32_t const Id) { IdsOut.push_back(Id); return true; });
+}
+
+bool CSpatialHashGrid::IsOverlapping(glm::vec3 const& Center, float const Radius) const
+{
+	// Stops at the first one.
+	return !VisitRadius(Center, Radius, [](uint32_t) { return false; });
+}
+
+bool CSpatialHashGrid::IntersectRaySphere(glm::vec3 const& Origin, glm::vec3 const& Direction, glm::vec3 const& Center, float const Radius, float& DistanceOut)
+{
+	glm::vec3 const m = Origin - Center;
+	float const b = glm::dot(m, Direction);
+	float const c = glm::dot(m, m) - Radius * Radius;
+	if (c > 0.f && b > 0.f) return false; // Outside and pointing away.
+	float const discriminant = b * b - c;
+	if (discriminant < 0.f) return false;
+	DistanceOut = std::max(0.f, -b - std::sqrt(discriminant));
+	return true;
+}
+
+bool CSpatialHashGrid::Raycast(glm::vec3 const& Origin, glm::vec3 const& Direction, float const MaxDistance, uint32_t& IdOut, float& DistanceOut) const
+{
+	if (NumberOfItems == 0) return false;
+	if (QueryStamps.size() < Items.size()) QueryStamps.resize(Items.size(), 0);
+	if (++QueryStamp == 0) { std::fill(QueryStamps.begin(), QueryStamps.end(), 0); QueryStamp = 1; }
+
+	// Items whose center is in a neighbouring cell may overlap the visited cell.
+	int32_t const neighbourhood = int32_t(std::ceil(MaxRadius * InverseCellSize));
+
+	// 3D DDA (Amanatides & Woo).
+	int32_t cell[3] = { GetCellCoordinate(Origin.x), GetCellCoordinate(Origin.y), GetCellCoordinate(Origin.z) };
+	int32_t step[3];
+	float nextBoundary[3], boundaryStep[3];
+	for (int iAxis = 0; iAxis < 3; iAxis++)
+	{
+		float const direction = Direction[iAxis];
+		if (direction > 0.f)
+		{
+			step[iAxis] = 1;
+			nextBoundary[iAxis] = ((cell[iAxis] + 1) * CellSize - Origin[iAxis]) / direction;
+			boundaryStep[iAxis] = CellSize / direction;
+		}
+		else if (direction < 0.f)
+		{
+			step[iAxis] = -1;
+			nextBoundary[iAxis] = (cell[iAxis] * CellSize - Origin[iAxis]) / direction;
+			boundaryStep[iAxis] = -CellSize / direction;
+		}
+		else
+		{
+			step[iAxis] = 0;
+			nextBoundary[iAxis] = boundaryStep[iAxis] = FLT_MAX;
+		}
+	}
+
+	bool hit = false;
+	float bestDistance = MaxDistance;
+	float cellEntryDistance = 0.f;
+	// Any item not found yet would be hit after cellEntryDistance: we can stop once it is further than the best hit.
+	while (cellEntryDistance <= bestDistance)
+	{
+		for (int32_t x = cell[0] - neighbourhood; x <= cell[0] + neighbourhood; x++)
+		for (int32_t y = cell[1] - neighbourhood; y <= cell[1] + neighbourhood; y++)
+		for (int32_t z = cell[2] - neighbourhood; z <= cell[2] + neighbourhood; z++)
+		{
+			vector<uint32_t> const* const ids = GetCell(x, y, z);
+			if (!ids) continue;
+			for (uint32_t const id : *ids)
+			{
+				if (QueryStamps[id] == QueryStamp) continue;
+				QueryStamps[id] = QueryStamp;
+
+				float distance;
+				SItem const& item = Items[id];
+				if (IntersectRaySphere(Origin, Direction, item.Position, item.Radius, distance) && distance <= bestDistance)
+				{
+					hit = true;
+					bestDistance = distance;
+					IdOut = id;
+				}
+			}
+		}
+
+		// Next cell along the ray.
+		int const axis = (nextBoundary[0] < nextBoundary[1]) ? (nextBoundary[0] < nextBoundary[2] ? 0 : 2) : (nextBoundary[1] < nextBoundary[2] ? 1 : 2);
+		cellEntryDistance = nextBoundary[axis];
+		nextBoundary[axis] += boundaryStep[axis];
+		cell[axis] += step[axis];
+	}
+
+	if (hit) DistanceOut = bestDistance;
+	return hit;
+}
\ No newline at end of file
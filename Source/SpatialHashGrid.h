@@ -0,0 +1,84 @@
+#pragma once
+#include "Types.h"
+
+// Loose uniform grid stored in a hash map: every item (a sphere) lives in the cell containing its center,
+// the queries are enlarged by the biggest radius seen so far. Items are identified by a user index
+// (e.g. the index of an entity in its pool) and are moved from one cell to another only when they change cell.
+class CSpatialHashGrid
+{
+public:
+	// CellSize should be bigger than the diameter of most items (in m).
+	explicit CSpatialHashGrid(float const CellSize);
+
+	// Inserts the item Id, or updates its position and radius.
+	void Update(uint32_t const Id, glm::vec3 const& Position, float const Radius);
+	void Remove(uint32_t const Id);
+	bool Contains(uint32_t const Id) const { return Id < Items.size() && Items[Id].InGrid; }
+	void Clear();
+
+	uint32_t GetNumberOfItems() const { return NumberOfItems; }
+
+	// Appends to IdsOut the items whose sphere intersects the query sphere.
+	void QueryRadius(glm::vec3 const& Center, float const Radius, vector<uint32_t>& IdsOut) const;
+	// True if at least one item intersects the query sphere.
+	bool IsOverlapping(glm::vec3 const& Center, float const Radius) const;
+	// Closest item whose sphere is hit by the ray (Direction normalized), walking the cells along the ray (3D DDA).
+	bool Raycast(glm::vec3 const& Origin, glm::vec3 const& Direction, float const MaxDistance, uint32_t& IdOut, float& DistanceOut) const;
+
+private:
+	struct SItem
+	{
+		glm::vec3 Position = glm::vec3(0.f);
+		float Radius = 0.f;
+		uint64_t CellKey = 0;
+		uint32_t IndexInCell = 0;
+		bool InGrid = false;
+	};
+
+	float const CellSize = 1.f;
+	float const InverseCellSize = 1.f;
+	// Queries are enlarged by this much (loose grid).
+	float MaxRadius = 0.f;
+
+	vector<SItem> Items; // Indexed by Id.
+	uint32_t NumberOfItems = 0;
+	unordered_map<uint64_t, vector<uint32_t>> Cells;
+
+	// Avoids testing the same item twice in Raycast.
+	mutable vector<uint32_t> QueryStamps;
+	mutable uint32_t QueryStamp = 0;
+
+	int32_t GetCellCoordinate(float const x) const { return int32_t(std::floor(x * InverseCellSize)); }
+	static uint64_t GetCellKey(int32_t const x, int32_t const y, int32_t const z);
+	vector<uint32_t> const* GetCell(int32_t const x, int32_t const y, int32_t const z) const;
+
+	void RemoveFromCell(SItem& Item, uint32_t const Id);
+	// Calls Visitor(Id) for each item intersecting the query sphere, until it returns false. Returns false if stopped.
+	template<typename FVisitor> bool VisitRadius(glm::vec3 const& Center, float const Radius, FVisitor&& Visitor) const;
+	static bool IntersectRaySphere(glm::vec3 const& Origin, glm::vec3 const& Direction, glm::vec3 const& Center, float const Radius, float& DistanceOut);
+};
+
+template<typename FVisitor>
+bool CSpatialHashGrid::VisitRadius(glm::vec3 const& Center, float const Radius, FVisitor&& Visitor) const
+{
+	float const reach = Radius + MaxRadius;
+	int32_t const xMin = GetCellCoordinate(Center.x - reach), xMax = GetCellCoordinate(Center.x + reach);
+	int32_t const yMin = GetCellCoordinate(Center.y - reach), yMax = GetCellCoordinate(Center.y + reach);
+	int32_t const zMin = GetCellCoordinate(Center.z - reach), zMax = GetCellCoordinate(Center.z + reach);
+
+	for (int32_t x = xMin; x <= xMax; x++)
+	for (int32_t y = yMin; y <= yMax; y++)
+	for (int32_t z = zMin; z <= zMax; z++)
+	{
+		vector<uint32_t> const* const cell = GetCell(x, y, z);
+		if (!cell) continue;
+		for (uint32_t const id : *cell)
+		{
+			SItem const& item = Items[id];
+			float const distance = Radius + item.Radius;
+			glm::vec3 const delta = item.Position - Center;
+			if (glm::dot(delta, delta) <= distance * distance && !Visitor(id)) return false;
+		}
+	}
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,52 @@
+#include "SubstepScheduler.h"
+
+CSubstepScheduler::CSubstepScheduler(float const StepDt, SSubstepSettings const& Settings) :
+	StepDt(StepDt),
+	Settings(Settings)
+{
+	assert(StepDt > 0.f);
+	assert(0.f < Settings.MinTimeScale && Settings.MinTimeScale <= 1.f);
+}
+
+CSubstepScheduler::SFrame CSubstepScheduler::Schedule(float const RealDt, uint32_t const StepsBehind, bool const StepsBlockFrame)
+{
+	SFrame frame;
+	float const scaledDt = RealDt * TimeScale;
+	Accumulator += scaledDt;
+	uint32_t const stepsDue = uint32_t(Accumulator / StepDt);
+
+	uint32_t steps = stepsDue;
+	if (Settings.MaxSubstepsPerFrame > 0)
+	{
+		steps = std::min(steps, Settings.MaxSubstepsPerFrame > StepsBehind ? Settings.MaxSubstepsPerFrame - StepsBehind : 0u);
+	}
+	// At least one step: as long as the frames are not longer than a step, the physics keeps up.
+	if (StepsBlockFrame && Settings.StepBudget > 0.f && AverageStepTime > 0.)
+	{
+		steps = std::min(steps, std::max(1u, uint32_t(Settings.StepBudget / AverageStepTime)));
+	}
+	frame.Steps = steps;
+	frame.DroppedTime = float(stepsDue - steps) * StepDt;
+	Accumulator = std::max(0.f, Accumulator - float(stepsDue) * StepDt);
+	TotalDroppedTime += frame.DroppedTime;
+
+	frame.GameDt = scaledDt;
+	if (!Settings.TimeDilation) return frame;
+
+	// The game only advances by what the physics simulates, and slows down so that the next frames fit.
+	if (steps < stepsDue)
+	{
+		frame.GameDt = std::max(0.f, scaledDt - frame.DroppedTime);
+		TimeScale = std::max(Settings.MinTimeScale, TimeScale * float(steps) / float(stepsDue));
+	}
+	else TimeScale = std::min(1.f, TimeScale + Settings.TimeScaleRecovery * RealDt);
+	return frame;
+}
+
+void CSubstepScheduler::ReportStepTime(uint32_t const Steps, double const TimeMs)
+{
+	if (Steps == 0) return;
+	double const stepTime = TimeMs / Steps;
+	// Smoothed, so that a single slow step does not halve the next frames' steps.
+	AverageStepTime = AverageStepTime > 0. ? 0.9 * AverageStepTime + 0.1 * stepTime : stepTime;
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+#pragma once
+#include "Types.h"
+
+// Limits of the fixed physics steps run per frame (cf. SPhysicsSettings::Substeps).
+struct SSubstepSettings
+{
+	// 0 = no limit.
+	uint32_t MaxSubstepsPerFrame = 4;
+	// Wall-clock time per frame the steps may take, from their measured cost, when the frame waits for them (inline
+	// physics). 0 = no budget: the steps then only depend on the frame times, as recordings and replays require.
+	float StepBudget = 8.f; // In ms.
+	// Steps cut: the game time slows down with the physics (down to MinTimeScale), instead of only the physics
+	// dropping time. The time scale then recovers by TimeScaleRecovery per second.
+	bool TimeDilation = false;
+	float MinTimeScale = 0.25f;
+	float TimeScaleRecovery = 0.5f;
+};
+
+// Fixed-step accumulator of the physics, protected against the spiral of death: after a long frame (window drag,
+// slow load...), running every step due would make the next frame even longer. The steps beyond the limits of
+// SSubstepSettings are dropped, and the simulation time they stood for is reported.
+class CSubstepScheduler
+{
+public:
+	CSubstepScheduler(float const StepDt, SSubstepSettings const& Settings);
+
+	struct SFrame
+	{
+		uint32_t Steps = 0;
+		float GameDt = 0.f;		// To advance the game by, in s (the frame time, scaled when dilating).
+		float DroppedTime = 0.f;	// Simulation time not stepped, in s.
+	};
+	// RealDt = frame time. StepsBehind = steps requested by the previous frames and not simulated yet (threaded
+	// physics): they count against MaxSubstepsPerFrame. StepBudget only applies if StepsBlockFrame: threaded, the
+	// steps cost the frame nothing, the backlog limits them instead.
+	SFrame Schedule(float const RealDt, uint32_t const StepsBehind = 0, bool const StepsBlockFrame = true);
+	// Measured cost of steps (SPhysicsSnapshot::StepTime), for the wall-clock budget.
+	void ReportStepTime(uint32_t const Steps, double const TimeMs);
+
+	// Between the last step and the next one.
+	float GetInterpolationFactor() const { return Accumulator / StepDt; }
+	float GetTimeScale() const { return TimeScale; }
+	double GetTotalDroppedTime() const { return TotalDroppedTime; } // In s.
+	double GetAverageStepTime() const { return AverageStepTime; } // In ms, 0 until measured.
+
+private:
+	float const StepDt;
+	SSubstepSettings const Settings;
+
+	float Accumulator = 0.f;
+	float TimeScale = 1.f;
+	double TotalDroppedTime = 0.;
+	double AverageStepTime = 0.;
+};
\ No newline at end of file
@@ -1,5 +1,9 @@
 #include "Texture.h"
 #include "CImage.h"
+#include "FileUtil.h"
+
+// DevIL keeps a current image and an error stack per process: the decodes are serialized.
+static std::mutex gDecodeMutex;
 
 CTexture::CTexture()
 {
@@ -8,7 +12,12 @@ CTexture::CTexture()
 
 CTexture::~CTexture()
 {
-	// todo
+	// The GL texture is released by m_resource, with the last copy.
+}
+
+STextureResource::~STextureResource()
+{
+	if (Id != (GLuint)-1) CTextureCache::Get().onRelease(*this);
 }
 
 void CTexture::Bind(GLenum num)
@@ -19,6 +28,14 @@ void CTexture::Bind(GLenum num)
 
 bool CTexture::Load(const string& filename, GLenum wrap_s, GLenum wrap_t)
 {
+	STextureImage image;
+	if (Decode(filename, image) == false) return false;
+	return Upload(image, wrap_s, wrap_t);
+}
+
+bool CTexture::Decode(const string& filename, STextureImage& image)
+{
+	std::lock_guard<std::mutex> lock(gDecodeMutex);
 	CImage img;
 	if (img.Load(filename) == false)
 	{
@@ -26,10 +43,28 @@ bool CTexture::Load(const string& filename, GLenum wrap_s, GLenum wrap_t)
 		return false;
 	}
 
-	GLenum pixelType = (img.pixelSize == 4 ? GL_RGBA : GL_RGB);
-	glGenTextures(1, &m_id);
+	// Copied out of DevIL's buffer, which goes away with img.
+	image.Width = img.lenx;
+	image.Height = img.leny;
+	image.PixelSize = img.pixelSize;
+	image.Pixels.assign(img.data, img.data + size_t(img.lenx) * img.leny * img.pixelSize);
+	return true;
+}
+
+bool CTexture::Upload(const STextureImage& image, GLenum wrap_s, GLenum wrap_t)
+{
+	if (image.Pixels.empty()) return false;
+
+	GLenum pixelType = (image.PixelSize == 4 ? GL_RGBA : GL_RGB);
+	m_resource = std::make_shared<STextureResource>();
+	glGenTextures(1, &m_resource->Id);
+	m_id = m_resource->Id;
+	// Mipmaps add a third.
+	m_resource->Bytes = size_t(image.Width) * image.Height * image.PixelSize * 4 / 3;
+	CTextureCache::Get().onCreate(*m_resource);
+
 	glBindTexture(GL_TEXTURE_2D, m_id);
-	glTexImage2D(GL_TEXTURE_2D, 0, pixelType, img.lenx, img.leny, 0, pixelType, GL_UNSIGNED_BYTE, img.data);
+	glTexImage2D(GL_TEXTURE_2D, 0, pixelType, image.Width, image.Height, 0, pixelType, GL_UNSIGNED_BYTE, image.Pixels.data());
 
 	// Sets how OpenGL filters mipmaps
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
@@ -44,3 +79,102 @@ bool CTexture::Load(const string& filename, GLenum wrap_s, GLenum wrap_t)
 	return true;
 }
 
+
+CTextureCache& CTextureCache::Get()
+{
+	static CTextureCache cache;
+	return cache;
+}
+
+CTexture CTextureCache::Acquire(const string& path, GLenum wrap_s, GLenum wrap_t)
+{
+	SPrepared prepared;
+	Prepare(path, prepared);
+	return Finish(prepared, wrap_s, wrap_t);
+}
+
+void CTextureCache::Prepare(const string& path, SPrepared& prepared)
+{
+	prepared = SPrepared();
+	prepared.CanonicalPath = getCanonicalPath(path);
+	if (find(prepared)) return;
+
+	// Unknown path: maybe another path to the same image.
+	prepared.bHasContentHash = getFileHash(prepared.CanonicalPath, prepared.ContentHash);
+	if (prepared.bHasContentHash && find(prepared)) return;
+
+	CTexture::Decode(prepared.CanonicalPath, prepared.Image);
+}
+
+CTexture CTextureCache::Finish(SPrepared& prepared, GLenum wrap_s, GLenum wrap_t)
+{
+	// Uploaded by another model since the preparation?
+	if (!prepared.Texture.IsReady()) find(prepared);
+	if (!prepared.Texture.IsReady() && prepared.Texture.Upload(prepared.Image, wrap_s, wrap_t))
+	{
+		insert(prepared, prepared.Texture);
+	}
+	prepared.Image = STextureImage();
+	return prepared.Texture;
+}
+
+bool CTextureCache::find(SPrepared& prepared)
+{
+	// Declared before the lock: it may be the last reference when it goes out of scope (cf. onRelease).
+	std::shared_ptr<STextureResource> resource;
+	std::lock_guard<std::mutex> lock(Mutex);
+	auto const byPath = m_byPath.find(prepared.CanonicalPath);
+	if (byPath != m_byPath.end()) resource = byPath->second.lock();
+	if (!resource && prepared.bHasContentHash)
+	{
+		auto const byContent = m_byContent.find(prepared.ContentHash);
+		if (byContent != m_byContent.end()) resource = byContent->second.lock();
+		if (resource) m_byPath[prepared.CanonicalPath] = resource;
+	}
+	if (!resource) return false;
+
+	prepared.Texture.m_resource = resource;
+	prepared.Texture.m_id = resource->Id;
+	m_numHits++;
+	return true;
+}
+
+void CTextureCache::insert(SPrepared& prepared, CTexture& texture)
+{
+	std::lock_guard<std::mutex> lock(Mutex);
+	texture.m_resource->CanonicalPath = prepared.CanonicalPath;
+	texture.m_resource->ContentHash = prepared.ContentHash;
+	m_byPath[prepared.CanonicalPath] = texture.m_resource;
+	if (prepared.bHasContentHash) m_byContent[prepared.ContentHash] = texture.m_resource;
+}
+
+void CTextureCache::onCreate(const STextureResource& resource)
+{
+	std::lock_guard<std::mutex> lock(Mutex);
+	m_residentBytes += resource.Bytes;
+	m_numResidentTextures++;
+	m_numUploads++;
+}
+
+void CTextureCache::onRelease(const STextureResource& resource)
+{
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		assert(m_residentBytes >= resource.Bytes && m_numResidentTextures > 0);
+		m_residentBytes -= resource.Bytes;
+		m_numResidentTextures--;
+		// Only dropping the entries of this resource: a new upload may have replaced them already.
+		auto const byPath = m_byPath.find(resource.CanonicalPath);
+		if (byPath != m_byPath.end() && byPath->second.expired()) m_byPath.erase(byPath);
+		auto const byContent = m_byContent.find(resource.ContentHash);
+		if (byContent != m_byContent.end() && byContent->second.expired()) m_byContent.erase(byContent);
+	}
+	// The world may outlive the GL context (glfwTerminate).
+	if (glfwGetCurrentContext()) glDeleteTextures(1, &resource.Id);
+}
+
+size_t CTextureCache::GetResidentBytes() const { std::lock_guard<std::mutex> lock(Mutex); return m_residentBytes; }
+uint32_t CTextureCache::GetNumberOfResidentTextures() const { std::lock_guard<std::mutex> lock(Mutex); return m_numResidentTextures; }
+uint32_t CTextureCache::GetNumberOfHits() const { std::lock_guard<std::mutex> lock(Mutex); return m_numHits; }
+uint32_t CTextureCache::GetNumberOfUploads() const { std::lock_guard<std::mutex> lock(Mutex); return m_numUploads; }
+
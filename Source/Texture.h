@@ -1,6 +1,25 @@
 #pragma once
 #include "Types.h"
 
+// Decoded pixels, RGB or RGBA 8 bits.
+struct STextureImage
+{
+	int				Width = 0;
+	int				Height = 0;
+	int				PixelSize = 0; // 3 or 4.
+	vector<uint8_t>	Pixels;
+};
+
+// GL texture shared by all the CTexture copies referring to it. Deleted with the last one (GL thread).
+struct STextureResource
+{
+	GLuint	Id = (GLuint)-1;
+	size_t	Bytes = 0;			// Resident in GL, mipmaps included.
+	string	CanonicalPath;		// Empty if not registered in the CTextureCache.
+	u64		ContentHash = 0;
+	~STextureResource();
+};
+
 class CTexture
 {
 	public:
@@ -12,4 +31,65 @@ class CTexture
 
 		bool Load(const string& filename, GLenum wrap_s, GLenum wrap_t);
 		void Bind(GLenum num);
+
+		// Load = decode (any thread, no GL call) + upload (GL thread).
+		static bool Decode(const string& filename, STextureImage& image);
+		bool Upload(const STextureImage& image, GLenum wrap_s, GLenum wrap_t);
+		bool IsReady() const { return m_id != (GLuint)-1; }
+
+	private:
+		// Copies are cheap handles: the GL texture goes away with the last of them.
+		std::shared_ptr<STextureResource> m_resource;
+
+		friend class CTextureCache;
+};
+
+// Process-wide cache of the textures loaded from files, reference-counted by the CTexture handles.
+// Keyed on the canonical path, then on the content hash: two paths to identical images share one GL texture.
+// The wrap modes are those of the first acquisition.
+class CTextureCache
+{
+	public:
+		static CTextureCache& Get();
+
+		// GL thread. The texture of path, decoded and uploaded if it is not resident yet.
+		CTexture Acquire(const string& path, GLenum wrap_s, GLenum wrap_t);
+
+		// Asynchronous version of Acquire: prepare (any thread) looks the texture up and decodes it if needed,
+		// finish (GL thread) uploads it unless an identical one got resident in the meantime.
+		struct SPrepared
+		{
+			string			CanonicalPath;
+			u64				ContentHash = 0;
+			bool			bHasContentHash = false;
+			CTexture		Texture;	// Ready if it was resident.
+			STextureImage	Image;		// Decoded otherwise.
+		};
+		void Prepare(const string& path, SPrepared& prepared);
+		CTexture Finish(SPrepared& prepared, GLenum wrap_s, GLenum wrap_t);
+
+		// All the GL textures created by CTexture, cached or not.
+		size_t		GetResidentBytes() const;
+		uint32_t	GetNumberOfResidentTextures() const;
+		// Acquisitions served without decoding, and uploads done.
+		uint32_t	GetNumberOfHits() const;
+		uint32_t	GetNumberOfUploads() const;
+
+	private:
+		mutable std::mutex Mutex;
+		unordered_map<string, std::weak_ptr<STextureResource>>	m_byPath;
+		unordered_map<u64, std::weak_ptr<STextureResource>>		m_byContent;
+		size_t		m_residentBytes = 0;
+		uint32_t	m_numResidentTextures = 0;
+		uint32_t	m_numHits = 0;
+		uint32_t	m_numUploads = 0;
+
+		// Looks the texture up by path, then by content if bHasContentHash (the path is then registered too).
+		bool find(SPrepared& prepared);
+		void insert(SPrepared& prepared, CTexture& texture);
+		void onCreate(const STextureResource& resource);
+		void onRelease(const STextureResource& resource);
+
+		friend class CTexture;
+		friend struct STextureResource;
 };
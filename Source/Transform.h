@@ -0,0 +1,45 @@
+#pragma once
+#include "Types.h"
+#include <glm/gtc/quaternion.hpp>
+#include <reactphysics3d/reactphysics3d.h>
+
+// Rotation, uniform scale and translation kept apart: the model matrix is Translate * Rotate * Scale.
+// Compared to a glm::mat4, the rotation never accumulates any scale or shear, and the normal matrix
+// comes straight from the rotation instead of an inverse-transpose.
+struct STransform
+{
+	glm::quat Rotation = glm::quat(1.f, 0.f, 0.f, 0.f);
+	glm::vec3 Translation = glm::vec3(0.f);
+	float Scale = 1.f;
+
+	// Same as glm::rotate/glm::translate on the model matrix: about and along the local axes.
+	void Rotate(float const Angle, glm::vec3 const& LocalAxis) { Rotation = glm::normalize(Rotation * glm::angleAxis(Angle, LocalAxis)); }
+	void Translate(glm::vec3 const& LocalOffset) { Translation += Rotation * (Scale * LocalOffset); }
+
+	// Local axes expressed in the world frame (normalized).
+	glm::vec3 GetAxis(int const Axis) const { glm::vec3 v(0.f); v[Axis] = 1.f; return Rotation * v; }
+
+	STransform Scaled(float const Factor) const { STransform t = *this; t.Scale *= Factor; return t; }
+
+	glm::mat4 GetMatrix() const
+	{
+		glm::mat3 const r = glm::mat3_cast(Rotation) * Scale;
+		return glm::mat4(glm::vec4(r[0], 0.f), glm::vec4(r[1], 0.f), glm::vec4(r[2], 0.f), glm::vec4(Translation, 1.f));
+	}
+	// The inverse-transpose of Rotate * Scale is Rotate / Scale. The shaders renormalize the normals,
+	// so the scale is dropped.
+	glm::mat3 GetNormalMatrix() const { return glm::mat3_cast(Rotation); }
+
+	// The physics engine has no scale.
+	rp3d::Transform ToPhysics() const
+	{
+		return rp3d::Transform(rp3d::Vector3(Translation.x, Translation.y, Translation.z), rp3d::Quaternion(Rotation.x, Rotation.y, Rotation.z, Rotation.w));
+	}
+	void SetFromPhysics(rp3d::Transform const& Transform)
+	{
+		rp3d::Vector3 const& position = Transform.getPosition();
+		rp3d::Quaternion const& orientation = Transform.getOrientation();
+		Translation = glm::vec3(position.x, position.y, position.z);
+		Rotation = glm::quat(orientation.w, orientation.x, orientation.y, orientation.z);
+	}
+};
\ No newline at end of file
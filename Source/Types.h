@@ -207,11 +207,14 @@
 #include <iterator>
 #include <algorithm>
 #include <functional>
+#include <memory>
 #include <numeric>
 #include <typeinfo>
 #include <bitset>
 #include <thread>
 #include <mutex>
+#include <condition_variable>
+#include <atomic>
 #include <chrono>
 #if defined(UNIX)
 //	#include <parallel/algorithm>	// __gnu_parallel::sort() + compiler : -fopenmp
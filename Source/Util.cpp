@@ -42,7 +42,21 @@ float CSquareWave::GetValue() const
 	return 0.f;
 }
 
-CRandomizer::CRandomizer() { mt = std::mt19937(unsigned int(std::chrono::steady_clock::now().time_since_epoch().count())); }
+uint64_t CRandomizer::GlobalSeed = uint64_t(std::chrono::steady_clock::now().time_since_epoch().count());
+std::atomic<uint64_t> CRandomizer::NumberOfRandomizersCreated(0);
+
+CRandomizer::CRandomizer()
+{
+	uint64_t const rank = NumberOfRandomizersCreated++;
+	std::seed_seq seed{ uint32_t(GlobalSeed), uint32_t(GlobalSeed >> 32), uint32_t(rank), uint32_t(rank >> 32) };
+	mt = std::mt19937(seed);
+}
+
+void CRandomizer::SetGlobalSeed(uint64_t const Seed)
+{
+	GlobalSeed = Seed;
+	NumberOfRandomizersCreated = 0;
+}
 
 static float Lerp(float const x1, float const x2, float const dx)
 {
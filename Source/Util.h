@@ -52,8 +52,14 @@ private:
 class CRandomizer
 {
 public:
+	// Every randomizer gets its own stream derived from the global seed and its creation rank:
+	// the same seed and the same sequence of creations give the same numbers (record/replay).
 	CRandomizer();
 
+	// Also restarts the creation rank. The default global seed comes from the clock.
+	static void SetGlobalSeed(uint64_t const Seed);
+	static uint64_t GetGlobalSeed() { return GlobalSeed; }
+
 	// Uniform distribution on [Min, Max].
 	float GetRandomFloat(float const Min, float const Max);
 	// Allows to use the same random number generated via mt() in the previous call to GetRandomFloat.
@@ -71,4 +77,7 @@ private:
 
 	// Between 0 and 1.
 	float LastRandomNumber = -1.f;
+
+	static uint64_t GlobalSeed;
+	static std::atomic<uint64_t> NumberOfRandomizersCreated;
 };
\ No newline at end of file
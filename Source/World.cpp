@@ -1,83 +1,218 @@
 #include "World.h"
 
+SPhysicsSettings CWorld::PhysicsSettings;
+
 CWorld::CWorld(GLFWwindow* const Window) : Window(Window)
 {
 	// Creating a standard perpective projection matrix.
-	assert(Window);
-	int windowWidth, windowHeight;
-	glfwGetFramebufferSize(Window, &windowWidth, &windowHeight);
+	int windowWidth = 1, windowHeight = 1;
+	if (Window) glfwGetFramebufferSize(Window, &windowWidth, &windowHeight);
 	ProjectionMatrix = glm::perspective(45.f, float(windowWidth) / float(windowHeight), 1.f, 350000.f);
+	CModel::SetLodViewportHeight(float(windowHeight));
 
 	// ReactPhysics3D stuff.
-	PhysicsWorld = PhysicsCommon.createPhysicsWorld();
+	rp3d::PhysicsWorld::WorldSettings worldSettings;
+	worldSettings.isSleepingEnabled = PhysicsSettings.SleepingEnabled;
+	worldSettings.defaultSleepLinearVelocity = PhysicsSettings.SleepLinearVelocity;
+	worldSettings.defaultSleepAngularVelocity = PhysicsSettings.SleepAngularVelocity;
+	worldSettings.defaultTimeBeforeSleep = PhysicsSettings.TimeBeforeSleep;
+	PhysicsWorld = PhysicsCommon.createPhysicsWorld(worldSettings);
 	PhysicsWorld->setIsGravityEnabled(false);
 	PhysicsWorld->setEventListener(&CollisionListener);
+	// Inline until the bodies are created, cf. the end of the constructor.
+	PhysicsThread = std::make_unique<CPhysicsThread>(PhysicsWorld, CollisionListener, PhysicsDt);
+	bool isNewSnapshot;
+	PhysicsSnapshot = &PhysicsThread->AcquireSnapshot(isNewSnapshot);
+	// Contact handlers per entity type pair, dispatched by Update after the physics substeps.
+	CollisionListener.SetHandler(EEntityType::Asteroid, EEntityType::Arwing, [](CEntity& Asteroid, CEntity& Arwing, SContactEvent const&)
+		{
+			static_cast<CAsteroid&>(Asteroid).OnArwingCollision(static_cast<CArwing const&>(Arwing));
+		});
+	CollisionListener.SetEntityResolver([this](EEntityType const Type, SEntityHandle const& Handle) -> CEntity*
+		{
+			if (Type == EEntityType::Asteroid) return AsteroidPool.Get(Handle);
+			if (Type == EEntityType::Arwing) return &Arwing;
+			return nullptr;
+		});
 
 	// Loading models of the game.
-	ArwingModel.Load(ROOT_DIR"Resources\\Meshes\\Arwing\\arwing_starlink.fbx");
-	AsteroidModel.Load(ROOT_DIR"Resources\\Meshes\\Cube\\Cube.obj");
+	// Headless: geometry and AABBs only (the entities and their rigid bodies need them), no GL resources.
+	bool const cpuOnly = IsHeadless();
+	if (cpuOnly) ArwingModel.Load(ROOT_DIR"Resources\\Meshes\\Arwing\\arwing_starlink.fbx", cpuOnly);
+	else ArwingModel.LoadAsync(ROOT_DIR"Resources\\Meshes\\Arwing\\arwing_starlink.fbx", AssetLoader);
+	// The cube is tiny and is the placeholder of the models still streaming.
+	AsteroidModel.Load(ROOT_DIR"Resources\\Meshes\\Cube\\Cube.obj", cpuOnly);
 	// AsteroidModel.Load(ROOT_DIR"Resources\\Meshes\\Asteroid\\asteroid.obj"); // Too many triangles, a met mon GPU en PLS !
-	LaserModel.Load(ROOT_DIR"Resources\\Meshes\\Cube\\Cube.obj");
-	SpaceBoxModel.Load(ROOT_DIR"Resources\\Meshes\\SpaceBox\\space.obj");
+	LaserModel.Load(ROOT_DIR"Resources\\Meshes\\Cube\\Cube.obj", cpuOnly);
+	if (cpuOnly) SpaceBoxModel.Load(ROOT_DIR"Resources\\Meshes\\SpaceBox\\space.obj", cpuOnly);
+	else SpaceBoxModel.LoadAsync(ROOT_DIR"Resources\\Meshes\\SpaceBox\\space.obj", AssetLoader);
 	SpaceBoxModelMatrix = glm::scale(SpaceBoxModelMatrix, glm::vec3(WorldHalfExtent));
+	ArwingModel.SetPlaceholder(&AsteroidModel);
+
+	// The Arwing's scale and rigid body depend on its AABB: only waiting for its geometry, the rest streams in.
+	AssetLoader.WaitUntil([this]() { return ArwingModel.GetState() != EAssetState::Loading; });
 
 	// Setting up the Arwing (the spacecraft controlled by the player).
 	Arwing.SetModel(&ArwingModel);
-	Arwing.InitializeRigidBody(PhysicsCommon, PhysicsWorld);
+	InitializeRigidBody(Arwing);
 	
 	// Filling the asteroid pool for constant-time acces and no instatiations in-game.
 	CAsteroid asteroid(this, &AsteroidModel);
-	asteroid.InitializeRigidBody(PhysicsCommon, PhysicsWorld);
+	InitializeRigidBody(asteroid);
 	AsteroidPool.FillWith(asteroid);
 	// asteroid is deleted at the end of this function.
 	// We call DestroyRigidBody to avoid that its rigid body remains dangling somewhere in ether...
-	asteroid.DestroyRigidBody(PhysicsWorld);
+	DestroyRigidBody(asteroid);
 
 	// Boom! Spawn 100 asteroids in one go!
 	for (int k = 0; k < 100; k++) SpawnAsteroid();
+
+	// From now on, the rigid bodies are only touched through ExecuteOnPhysics.
+	EPhysicsThreading const threading = PhysicsSettings.Threading;
+	PhysicsThread->Start(threading == EPhysicsThreading::Always || (threading == EPhysicsThreading::Windowed && !IsHeadless()));
 }
 
 void CWorld::Update(float const Dt)
 {
+	PROFILE_CPU_SCOPE("CWorld::Update");
+	if (Recorder) Recorder->WriteFrame(Dt);
+
+	// Physics steps of the frame, bounded (cf. SSubstepSettings). The steps the physics thread has not caught up with
+	// yet count against the limit, the wall-clock budget only when the frame waits for them (inline).
+	// With time dilation, the whole game advances by less than Dt.
+	bool const threaded = PhysicsThread->IsThreaded();
+	CSubstepScheduler::SFrame const frame = PhysicsScheduler.Schedule(Dt, PhysicsStats.StepsBehind, !threaded);
+	float const gameDt = frame.GameDt;
+
 	// Arwing regular update.
-	Arwing.Update(Dt);
+	Arwing.Update(gameDt);
 	Camera.UpdateViewMatrix(Arwing.GetCameraTarget()); //  mettre plus bas peut-tre...
 
-	// Physics update.
-	TimeAccumulator += Dt;
-	while (TimeAccumulator >= PhysicsDt)
+	// Physics update: the substeps are requested after the changes of this frame (the Arwing's transform, spawns...),
+	// the game goes on with the latest snapshot published by the physics thread (this frame's one if inline).
+	// The backlog is measured against the steps requested before this frame's: those were only just submitted.
+	uint64_t const stepsRequestedBefore = PhysicsThread->GetStepsRequested();
+	{
+		PROFILE_CPU_SCOPE("Physics step");
+		PhysicsThread->Step(frame.Steps);
+	}
+	bool isNewSnapshot;
+	PhysicsSnapshot = &PhysicsThread->AcquireSnapshot(isNewSnapshot);
+	PhysicsStats = SPhysicsStats();
+	PhysicsStats.StepsBehind = uint32_t(stepsRequestedBefore - std::min(stepsRequestedBefore, PhysicsSnapshot->StepIndex));
+	PhysicsStats.DroppedTime = frame.DroppedTime;
+	PhysicsStats.TotalDroppedTime = PhysicsScheduler.GetTotalDroppedTime();
+	PhysicsStats.TimeScale = PhysicsScheduler.GetTimeScale();
+	if (isNewSnapshot)
 	{
-		PhysicsWorld->update(PhysicsDt);
-		TimeAccumulator -= PhysicsDt;
+		PhysicsStats.Substeps = PhysicsSnapshot->Substeps;
+		PhysicsStats.ContactPairs = PhysicsSnapshot->ContactPairs;
+		PhysicsStats.StepTime = PhysicsSnapshot->StepTime;
+		PhysicsScheduler.ReportStepTime(PhysicsSnapshot->Substeps, PhysicsSnapshot->StepTime);
+		PROFILE_CPU_SCOPE("Contact events");
+		CollisionListener.Dispatch(PhysicsSnapshot->Events);
 	}
-	InterpolationFactor = TimeAccumulator / PhysicsDt;
+	// Rendering one step behind the latest snapshot, relative to its own StepIndex: the render clock advances with the
+	// game time and is kept between the two transforms of the snapshot, so that a snapshot a frame late still moves
+	// smoothly instead of freezing on its last transform. Inline, the snapshot is this frame's: the clock is the
+	// scheduler's accumulator, which keeps the replays deterministic.
+	double const previousStep = double(PhysicsSnapshot->StepIndex) - 1.;
+	if (threaded) RenderStep += double(gameDt) / PhysicsDt;
+	else RenderStep = previousStep + PhysicsScheduler.GetInterpolationFactor();
+	RenderStep = glm::clamp(RenderStep, previousStep, previousStep + 1.);
+	InterpolationFactor = float(RenderStep - previousStep);
 	assert(0.f <= InterpolationFactor && InterpolationFactor <= 1.f);
 
 	// Asteroids regular updates. There should have been the same thing for laser projectiles...
-	AsteroidPool.UpdateAllActiveEntities(Dt);
+	{
+		PROFILE_CPU_SCOPE("Asteroid pool update");
+		AsteroidPool.UpdateAllActiveEntitiesParallel(gameDt, JobSystem);
+	}
+	{
+		PROFILE_CPU_SCOPE("Asteroid grid update");
+		UpdateAsteroidGrid();
+	}
 
-	_Time += Dt;
+	_Time += gameDt;
 	if (_Time >= AsteroidSpawnTime)
 	{
 		for (uint16_t k = 0; k < AsteroidsToSpawn; k++) SpawnAsteroid();
 		_Time = 0.f;
 	}
+
+	if (Recorder && Recorder->IsStateHashDue()) Recorder->WriteStateHash(ComputeStateHash());
+}
+
+void CWorld::StartRecording(string const& Path)
+{
+	Recorder = std::make_unique<CReplayWriter>(Path, CRandomizer::GetGlobalSeed(), PhysicsSettings);
+}
+
+// FNV-1a.
+static void HashBytes(uint64_t& Hash, void const* const Data, size_t const Size)
+{
+	uint8_t const* const bytes = static_cast<uint8_t const*>(Data);
+	for (size_t k = 0; k < Size; k++) { Hash ^= bytes[k]; Hash *= 1099511628211ull; }
+}
+
+uint64_t CWorld::ComputeStateHash() const
+{
+	uint64_t hash = 14695981039346656037ull;
+	glm::mat4 const arwingMatrix = Arwing.GetDrawModelMatrix();
+	HashBytes(hash, &arwingMatrix, sizeof(arwingMatrix));
+	// The active list order is deterministic too.
+	AsteroidPool.ForEachActiveEntity([&hash](uint32_t const Index, CAsteroid const& Asteroid)
+		{
+			glm::vec3 const position = Asteroid.GetPosition();
+			HashBytes(hash, &Index, sizeof(Index));
+			HashBytes(hash, &position, sizeof(position));
+		});
+	return hash;
 }
 
 void CWorld::Render()
 {
+	if (IsHeadless()) return;
+	PROFILE_CPU_SCOPE("CWorld::Render");
+
+	// GL side of the streamed assets, within the frame's budget.
+	{
+		PROFILE_CPU_SCOPE("Asset uploads");
+		AssetLoader.ProcessUploads(AssetUploadBudget);
+	}
+
 	glm::vec3 const& cameraPosition = Camera.GetPosition();
 	glm::mat4 const& viewMatrix = Camera.GetViewMatrix();
 
-	SpaceBoxModel.Draw(cameraPosition, SpaceBoxModelMatrix, viewMatrix, ProjectionMatrix, LightPosition, LightColor);
-	Arwing.Draw(cameraPosition, viewMatrix, ProjectionMatrix, LightPosition, LightColor);
+	SRenderFrame frame;
+	frame.View = viewMatrix;
+	frame.Proj = ProjectionMatrix;
+	frame.CameraPosition = cameraPosition;
+	frame.LightPosition = LightPosition;
+	frame.LightColor = LightColor;
+	RenderQueue.Begin(frame);
+
+	{
+		PROFILE_CPU_SCOPE("Submit");
+		SpaceBoxModel.Submit(RenderQueue, SpaceBoxModelMatrix);
+		Arwing.Submit(RenderQueue, cameraPosition, ProjectionMatrix);
+
+		// Only the asteroids intersecting the view frustum are submitted.
+		SFrustum frustum; frustum.ExtractFrom(ProjectionMatrix * viewMatrix);
+		AsteroidPool.SubmitAllActiveEntitiesInstanced(RenderQueue, cameraPosition, ProjectionMatrix, &frustum);
+	}
 
-	AsteroidPool.DrawAllActiveEntities(cameraPosition, viewMatrix, ProjectionMatrix, LightPosition, LightColor);
+	// Sorted by state, so that the program, texture and VAO binds are only issued when they change.
+	{
+		PROFILE_GPU_SCOPE("Render queue");
+		RenderQueue.Flush();
+	}
 }
 
 void CWorld::HandleKeyboardInputs(int Key, int Scancode, int Action, int Mods)
 {
-	if (Key == GLFW_KEY_ESCAPE && Action == GLFW_PRESS) { glfwSetWindowShouldClose(Window, GLFW_TRUE); return; }
+	if (Recorder) Recorder->WriteKey(Key, Scancode, Action, Mods);
+	if (Key == GLFW_KEY_ESCAPE && Action == GLFW_PRESS) { if (Window) glfwSetWindowShouldClose(Window, GLFW_TRUE); return; }
 
 	if (Action == GLFW_PRESS)
 	{
@@ -107,11 +242,55 @@ void CWorld::SpawnAsteroid()
 	CAsteroid::SParams params;
 	params.PlayerPosition = Arwing.GetPosition();
 
-	asteroid->Randomize(params);
+	// Avoids spawning asteroids into each other.
+	for (uint8_t attempt = 0; attempt < MaxSpawnAttempts; attempt++)
+	{
+		asteroid->Randomize(params);
+		if (!AsteroidGrid.IsOverlapping(asteroid->GetPosition(), asteroid->GetBoundingRadius())) break;
+	}
 	asteroid->SetActive(true);
+
+	// The contacts of the body are reported with the handle of this life of the asteroid from the next steps on.
+	SEntityHandle const handle = AsteroidPool.GetHandle(asteroid);
+	ExecuteOnPhysics([asteroid, handle]() { asteroid->SetContactHandle(handle); });
+	AsteroidGrid.Update(handle.Index, asteroid->GetPosition(), asteroid->GetBoundingRadius());
+}
+
+void CWorld::UpdateAsteroidGrid()
+{
+	for (uint32_t const index : AsteroidPool.GetEntitiesReleasedByLastUpdate()) AsteroidGrid.Remove(index);
+	// Only the asteroids changing cell touch the hash map.
+	AsteroidPool.ForEachActiveEntity([this](uint32_t const Index, CAsteroid const& Asteroid)
+		{
+			AsteroidGrid.Update(Index, Asteroid.GetPosition(), Asteroid.GetBoundingRadius());
+		});
+}
+
+void CWorld::QueryAsteroids(glm::vec3 const& Center, float const Radius, vector<CAsteroid*>& AsteroidsOut)
+{
+	static thread_local vector<uint32_t> indexes;
+	indexes.clear();
+	AsteroidGrid.QueryRadius(Center, Radius, indexes);
+	for (uint32_t const index : indexes) AsteroidsOut.push_back(AsteroidPool.GetEntityAt(index));
+}
+
+CAsteroid* CWorld::RaycastAsteroids(glm::vec3 const& Origin, glm::vec3 const& Direction, float const MaxDistance, float* const DistanceOut)
+{
+	uint32_t index; float distance;
+	if (!AsteroidGrid.Raycast(Origin, Direction, MaxDistance, index, distance)) return nullptr;
+	if (DistanceOut) *DistanceOut = distance;
+	return AsteroidPool.GetEntityAt(index);
 }
 
 void CWorld::InitializeRigidBody(CEntity& Entity)
 {
 	Entity.InitializeRigidBody(PhysicsCommon, PhysicsWorld);
+	Entity.SetPhysicsSlot(PhysicsThread->AddBody(Entity.GetRigidBody()));
+}
+
+void CWorld::DestroyRigidBody(CEntity& Entity)
+{
+	PhysicsThread->RemoveBody(Entity.GetPhysicsSlot());
+	Entity.SetPhysicsSlot(CPhysicsThread::InvalidSlot);
+	Entity.DestroyRigidBody(PhysicsWorld);
 }
\ No newline at end of file
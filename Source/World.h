@@ -1,17 +1,71 @@
 #pragma once
-#include "CollisionListener.h"
+#include "PhysicsThread.h"
+#include "SubstepScheduler.h"
+#include "CollisionShapeCache.h"
 #include "Model.h"
 #include "Arwing.h"
 #include "Camera.h"
+#include "JobSystem.h"
+#include "Frustum.h"
+#include "SpatialHashGrid.h"
+#include "Profiler.h"
+#include "Replay.h"
+#include "AssetLoader.h"
 #include "EntityPool.h"
 
+// Where the physics steps run (cf. CPhysicsThread).
+enum class EPhysicsThreading : uint8_t
+{
+	Inline,		// In Update: the game reads the transforms of this very frame, as a recording requires.
+	Windowed,	// On its own thread when there is a window, inline headless.
+	Always		// On its own thread, headless too (benchmarks).
+};
+
+// Physics settings, read when a world is created (cf. CWorld::SetPhysicsSettings).
+// The ones changing the simulation are recorded in the replays, which are played back with them.
+struct SPhysicsSettings
+{
+	// Asteroid-asteroid pairs are rejected by the broad phase unless true (cf. CEntity::GetCollideWithMask).
+	bool AsteroidSelfCollisions = false;
+	// Bodies slower than these velocities for TimeBeforeSleep are put to sleep (not simulated until woken up).
+	bool SleepingEnabled = true;
+	float SleepLinearVelocity = 0.02f;	// In m/s.
+	float SleepAngularVelocity = 0.05f;	// In rad/s.
+	float TimeBeforeSleep = 1.f;		// In s.
+	// The broad phase inflates the AABBs stored in its tree by this fraction of their size, so that moving bodies
+	// are reinserted less often. It is a compile-time constant of rp3d (DYNAMIC_TREE_FAT_AABB_INFLATE_PERCENTAGE):
+	// changing it means rebuilding the library.
+	static constexpr float FatAABBInflation = float(rp3d::DYNAMIC_TREE_FAT_AABB_INFLATE_PERCENTAGE);
+	EPhysicsThreading Threading = EPhysicsThreading::Windowed;
+	// Steps per frame limits. Recorded in the replays, but for the wall-clock budget: they have none (StepBudget = 0).
+	SSubstepSettings Substeps;
+};
+
+// Physics counters of the steps whose results reached the last Update.
+struct SPhysicsStats
+{
+	uint32_t Substeps = 0;
+	uint32_t ContactPairs = 0; // Reported by the narrow phase (cf. CCollisionListener).
+	double StepTime = 0.; // In ms, all the substeps.
+	// Steps requested by the previous Updates but not simulated yet when the game read the transforms (threaded
+	// physics only): the steps of this Update are not counted.
+	uint32_t StepsBehind = 0;
+	// Simulation time dropped by the substep limits (cf. CSubstepScheduler), in s: this Update's and since the start.
+	float DroppedTime = 0.f;
+	double TotalDroppedTime = 0.;
+	float TimeScale = 1.f; // Below 1 while dilating time.
+};
+
 // Basically a container for everything in the game.
 class CWorld
 {
 public:
+	// Pass a null Window to run the world headless: no GLFW, no OpenGL, models are loaded CPU-side only.
 	CWorld(GLFWwindow* const Window);
 
-	// Dt = dynamic game delta time.
+	bool IsHeadless() const { return !Window; }
+
+	// Dt = dynamic game delta time (scaled down while the physics dilates time, cf. SSubstepSettings).
 	void Update(float const Dt);
 	void Render();
 
@@ -19,12 +73,54 @@ public:
 
 	void SpawnAsteroid();
 
+	// Between the transforms before and after the last step of the physics snapshot, from the render clock.
 	float GetInterpolationFactor() const { return InterpolationFactor; }
+	// Latest physics snapshot, acquired once per Update (read by the asteroid updates).
+	SPhysicsSnapshot const& GetPhysicsSnapshot() const { return *PhysicsSnapshot; }
+
+	static void SetPhysicsSettings(SPhysicsSettings const& Settings) { PhysicsSettings = Settings; }
+	static SPhysicsSettings const& GetPhysicsSettings() { return PhysicsSettings; }
+	SPhysicsStats const& GetPhysicsStats() const { return PhysicsStats; }
+	// For the diagnostics that need more than SPhysicsStats (benchmarks), with inline physics only.
+	rp3d::PhysicsWorld const* GetPhysicsWorld() const { return PhysicsWorld; }
 
+	// Changes to the rigid bodies, run in order by the thread stepping the physics world (cf. CPhysicsThread::Execute).
+	void ExecuteOnPhysics(CPhysicsThread::FCommand&& Command) { PhysicsThread->Execute(std::move(Command)); }
+	uint64_t GetPhysicsStepsRequested() const { return PhysicsThread->GetStepsRequested(); }
+
+	// Create and destroy the rigid body of the entity, registered into the physics snapshots.
 	void InitializeRigidBody(CEntity& Entity);
+	void DestroyRigidBody(CEntity& Entity);
+	// Shapes shared by the rigid bodies of the entities.
+	CCollisionShapeCache& GetCollisionShapes() { return CollisionShapes; }
 
 	glm::vec3 GetArwingPosition() const { return Arwing.GetPosition(); }
 
+	// Proximity queries on the asteroids (targeting, lasers...), answered by the spatial hash grid.
+	// Not const: the asteroids found are handed out to be acted upon.
+	void QueryAsteroids(glm::vec3 const& Center, float const Radius, vector<CAsteroid*>& AsteroidsOut);
+	// Closest asteroid hit by the ray (Direction normalized), nullptr if none within MaxDistance.
+	CAsteroid* RaycastAsteroids(glm::vec3 const& Origin, glm::vec3 const& Direction, float const MaxDistance, float* const DistanceOut = nullptr);
+
+	// Records the session (seed, Dt, keyboard inputs) to Path until StopRecording or the world destruction.
+	// Has to be called before the first Update, with the world created right after CRandomizer::SetGlobalSeed,
+	// and with inline physics (cf. SPhysicsSettings::Threading).
+	void StartRecording(string const& Path);
+	void StopRecording() { Recorder.reset(); }
+	// Hash of the simulation state (Arwing and asteroid transforms), to compare replays and builds.
+	uint64_t ComputeStateHash() const;
+
+	// Time per frame given to the GL uploads of the assets streamed in the background.
+	void SetAssetUploadBudget(float const BudgetMs) { AssetUploadBudget = BudgetMs; }
+	// All the models are loaded, GL resources included.
+	bool AreAssetsReady() const { return AssetLoader.IsIdle(); }
+
+	// State changes and draws of the last Render.
+	SRenderStats const& GetRenderStats() const { return RenderQueue.GetStats(); }
+
+	// Asteroid culling counters of the last Render.
+	SCullingStats const& GetCullingStats() const { return AsteroidPool.GetCullingStats(); }
+
 private:
 	// Used to scale the skybox (SpaceBox, 1 * 1 * 1 m cube).
 	float const WorldHalfExtent = 2.e5f; // The world is a 400000m cube.
@@ -43,27 +139,49 @@ private:
 	CModel LaserModel;
 	CModel SpaceBoxModel;
 	glm::mat4 SpaceBoxModelMatrix = glm::mat4(1.f);
+	// Streams the models in the background. Declared after them: its threads are stopped before they are destroyed.
+	CAssetLoader AssetLoader;
+	float AssetUploadBudget = 2.f; // In ms.
 
 	// The asteroid pool for constant-time acces and no instatiations in-game.
 	CEntityPool<CAsteroid, 6000> AsteroidPool;
+	// Threads updating the asteroid pool.
+	CJobSystem JobSystem;
+	// Asteroid bounding spheres indexed by pool slot, kept in sync after each pool update.
+	CSpatialHashGrid AsteroidGrid = CSpatialHashGrid(400.f); // Cells bigger than the biggest asteroid.
+	// Number of tries to find a free spot for a new asteroid.
+	uint8_t const MaxSpawnAttempts = 4;
+	void UpdateAsteroidGrid();
 	// Pas le temps...
 	// CEntityPool<CLaser, 200> LaserPool;
 
 	// Physics.
 	rp3d::PhysicsCommon PhysicsCommon;
 	rp3d::PhysicsWorld* PhysicsWorld = nullptr;
+	CCollisionShapeCache CollisionShapes = CCollisionShapeCache(PhysicsCommon);
 	CCollisionListener CollisionListener;
 	float const PhysicsDt = 1.f / 60.f;
-	float TimeAccumulator = 0.f;
+	static SPhysicsSettings PhysicsSettings;
+	CSubstepScheduler PhysicsScheduler = CSubstepScheduler(PhysicsDt, PhysicsSettings.Substeps);
 	float InterpolationFactor = 0.f;
+	// Time shown by the game, in physics steps: one step behind the latest snapshot (cf. Update).
+	double RenderStep = 0.;
+	SPhysicsStats PhysicsStats;
+	// Declared after the physics world and the listener: its thread is stopped before they are destroyed.
+	std::unique_ptr<CPhysicsThread> PhysicsThread;
+	SPhysicsSnapshot const* PhysicsSnapshot = nullptr;
 
 	// Rendering stuff.
 	GLFWwindow* const Window = nullptr;
 	glm::mat4 ProjectionMatrix;
+	CRenderQueue RenderQueue;
 	CCamera<20> Camera = CCamera<20>(CCameraTarget(), 0.f, 1.f);
 	glm::vec3 const LightPosition = glm::vec3(0.f, 1000.f, 0.f);
 	glm::vec3 const LightColor = glm::vec3(1.f, 1.f, 1.f);
 
 	// Time tracking.
 	float _Time = 0.f;
+
+	// Non-null while recording.
+	std::unique_ptr<CReplayWriter> Recorder;
 };
\ No newline at end of file